@@ -0,0 +1,196 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bgzfsource.h"
+
+
+#define BLOCKS_PER_THREAD 4
+
+
+struct BgzfBlock : public WorkerTask {
+  unsigned char compressed[BGZF_MAX_BLOCK_SIZE];
+  char data[BGZF_MAX_BLOCK_SIZE];
+  size_t compressedSize;  //raw deflate payload, without header and footer
+  size_t dataSize;
+  unsigned int crc;
+  unsigned int isize;
+  size_t index;           //block number in the file, for error messages
+  bool ok;
+
+  void run();
+};
+
+
+void BgzfBlock::run()
+{
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  ok = false;
+  dataSize = 0;
+
+  if (Z_OK != inflateInit2(&stream, -15))  //raw deflate
+    return;
+
+  stream.next_in = compressed;
+  stream.avail_in = compressedSize;
+  stream.next_out = (Bytef *) data;
+  stream.avail_out = BGZF_MAX_BLOCK_SIZE;
+
+  int ret = inflate(&stream, Z_FINISH);
+  dataSize = stream.total_out;
+  inflateEnd(&stream);
+
+  ok = (Z_STREAM_END == ret)
+    && (dataSize == isize)
+    && (crc == crc32(0, (const Bytef *) data, dataSize));
+}
+
+
+static unsigned int littleEndian16(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+
+static unsigned int littleEndian32(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+
+
+
+BgzfSource::BgzfSource(size_t threads) : m_pool(threads)
+{
+  m_fptr = 0;
+  m_head = 0;
+  m_inFlight = 0;
+  m_offset = 0;
+  m_blockCount = 0;
+  m_fileEnd = false;
+  m_failed = false;
+
+  m_blocks.resize( BLOCKS_PER_THREAD * m_pool.threads() + 1 );
+  for (size_t i = 0; i < m_blocks.size(); i++)
+    m_blocks[i] = new BgzfBlock;
+}
+
+
+BgzfSource::~BgzfSource()
+{
+  m_pool.waitAll();
+  for (size_t i = 0; i < m_blocks.size(); i++)
+    delete m_blocks[i];
+  if (0 != m_fptr)
+    fclose(m_fptr);
+}
+
+
+bool BgzfSource::isBgzf(const unsigned char *header)
+{
+  return 0x1f == header[0] && 0x8b == header[1] && 8 == header[2]
+    && (header[3] & 4)  //FEXTRA
+    && 'B' == header[12] && 'C' == header[13]
+    && 2 == littleEndian16(header + 14);
+}
+
+
+bool BgzfSource::open(const char *file)
+{
+  m_fptr = fopen(file, "rb");
+  if (0 == m_fptr) {
+    fprintf(stderr, "ERROR cannot open %s\n", file);
+    return false;
+  }
+  return true;
+}
+
+
+// reads one block from the file without inflating it, false at end of file
+bool BgzfSource::readBlock(BgzfBlock *block)
+{
+  unsigned char header[BGZF_HEADER_SIZE];
+  size_t count = fread(header, 1, BGZF_HEADER_SIZE, m_fptr);
+  if (0 == count && !ferror(m_fptr))
+    return false;
+
+  if (BGZF_HEADER_SIZE != count || !isBgzf(header)) {
+    fprintf(stderr, "ERROR invalid bgzf block header at block %zu\n", m_blockCount);
+    m_failed = true;
+    return false;
+  }
+
+  //the BC subfield is first in practice, any other extra subfields are skipped
+  size_t extraLength = littleEndian16(header + 10);
+  size_t blockSize = littleEndian16(header + 16) + 1;
+  size_t remaining = blockSize - 12 - extraLength;   //deflate data, crc and isize
+  if (extraLength < 6 || blockSize <= 12 + extraLength + 8 || remaining > BGZF_MAX_BLOCK_SIZE
+      || 0 != fseeko(m_fptr, extraLength - 6, SEEK_CUR)) {
+    fprintf(stderr, "ERROR invalid bgzf block size at block %zu\n", m_blockCount);
+    m_failed = true;
+    return false;
+  }
+
+  if (remaining != fread(block->compressed, 1, remaining, m_fptr)) {
+    fprintf(stderr, "ERROR bgzf input is truncated at block %zu\n", m_blockCount);
+    m_failed = true;
+    return false;
+  }
+
+  block->compressedSize = remaining - 8;
+  block->crc = littleEndian32(block->compressed + remaining - 8);
+  block->isize = littleEndian32(block->compressed + remaining - 4);
+  block->index = m_blockCount++;
+  return true;
+}
+
+
+// keep the ring full, so workers inflate ahead of the reader
+void BgzfSource::submitBlocks()
+{
+  while (!m_fileEnd && !m_failed && m_inFlight < m_blocks.size()) {
+    BgzfBlock *block = m_blocks[ (m_head + m_inFlight) % m_blocks.size() ];
+    if (!readBlock(block)) {
+      m_fileEnd = true;
+      break;
+    }
+    m_pool.submit(block);
+    m_inFlight++;
+  }
+}
+
+
+size_t BgzfSource::read(char *buffer, size_t n)
+{
+  size_t copied = 0;
+  while (copied < n && !m_failed) {
+    submitBlocks();
+    if (0 == m_inFlight)
+      break;
+
+    BgzfBlock *block = m_blocks[m_head];
+    m_pool.wait(block);
+    if (!block->ok) {
+      fprintf(stderr, "ERROR could not inflate bgzf block %zu\n", block->index);
+      m_failed = true;
+      break;
+    }
+
+    size_t count = block->dataSize - m_offset;
+    if (count > n - copied)
+      count = n - copied;
+    memcpy(buffer + copied, block->data + m_offset, count);
+    copied += count;
+    m_offset += count;
+
+    if (m_offset == block->dataSize) {
+      m_head = (m_head + 1) % m_blocks.size();
+      m_inFlight--;
+      m_offset = 0;
+    }
+  }
+
+  return m_failed ? 0 : copied;
+}
@@ -0,0 +1,53 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef BGZFSOURCE_H
+#define BGZFSOURCE_H
+
+#include <vector>
+
+#include "bytesource.h"
+#include "threadpool.h"
+
+
+#define BGZF_HEADER_SIZE 18
+#define BGZF_MAX_BLOCK_SIZE 65536
+
+
+struct BgzfBlock;
+
+
+//! BGZF (bgzip) file, blocks are inflated in parallel and handed out in file order
+// Every BGZF block is a complete gzip member of at most 64KB, so blocks can be
+// inflated independently.  A window of blocks is kept in flight on the thread
+// pool while the caller consumes the oldest one.
+class BgzfSource : public ByteSource {
+ public:
+  BgzfSource(size_t threads);
+  ~BgzfSource();
+
+  bool open(const char *file);
+  size_t read(char *buffer, size_t n);
+  bool failed() const { return m_failed; }
+
+  static bool isBgzf(const unsigned char *header);
+
+ private:
+  FILE *m_fptr;
+  ThreadPool m_pool;
+
+  std::vector<BgzfBlock*> m_blocks;  //ring of blocks in flight
+  size_t m_head;      //oldest block, the one being read
+  size_t m_inFlight;  //blocks submitted and not yet consumed
+  size_t m_offset;    //read position inside the head block
+  size_t m_blockCount;
+
+  bool m_fileEnd;
+  bool m_failed;
+
+  bool readBlock(BgzfBlock *block);
+  void submitBlocks();
+};
+
+
+#endif
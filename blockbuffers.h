@@ -0,0 +1,87 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef BLOCKBUFFERS_H
+#define BLOCKBUFFERS_H
+
+#include <stddef.h>
+#include <vector>
+
+
+#define DEFAULT_MAX_MEMORY_MB 1024  //for the blocks of the per-sample variables and their caches
+
+
+// snps per block when each snp takes bytesPerSNP, at least one and at most nSNPs
+static inline size_t blockSNPs(size_t maxBytes, size_t bytesPerSNP, size_t nSNPs)
+{
+  size_t n = (0 == bytesPerSNP) ? nSNPs : maxBytes / bytesPerSNP;
+  if (n > nSNPs)
+    n = nSNPs;
+  return (0 == n) ? 1 : n;
+}
+
+
+
+//! Buffers for the blocks variables are written in, reused once released
+// A variable takes one buffer for all its blocks and gives it back when it
+// is written, so the next one gets the same memory rather than a new
+// allocation. Free buffers too small for a request are dropped, so what is
+// held stays near the largest set of blocks in use at once.
+class BlockBuffers {
+ public:
+  BlockBuffers() { }
+  ~BlockBuffers() {
+    for (size_t i = 0; i < m_free.size(); i++)
+      delete[] m_free[i].data;
+    for (size_t i = 0; i < m_used.size(); i++)
+      delete[] m_used[i].data;
+  }
+
+  unsigned char *acquire(size_t bytes) {
+    size_t best = m_free.size();
+    for (size_t i = 0; i < m_free.size(); i++) {
+      if (m_free[i].bytes >= bytes && (best == m_free.size() || m_free[i].bytes < m_free[best].bytes))
+        best = i;
+    }
+
+    Buffer buffer;
+    if (best < m_free.size()) {
+      buffer = m_free[best];
+      m_free.erase(m_free.begin() + best);
+    }
+    else {
+      for (size_t i = 0; i < m_free.size(); i++)
+        delete[] m_free[i].data;
+      m_free.clear();
+      buffer.data = new unsigned char[(0 == bytes) ? 1 : bytes];
+      buffer.bytes = bytes;
+    }
+    m_used.push_back(buffer);
+    return buffer.data;
+  }
+
+  void release(unsigned char *data) {
+    for (size_t i = 0; i < m_used.size(); i++) {
+      if (m_used[i].data == data) {
+        m_free.push_back(m_used[i]);
+        m_used.erase(m_used.begin() + i);
+        return;
+      }
+    }
+  }
+
+ private:
+  struct Buffer {
+    unsigned char *data;
+    size_t bytes;
+  };
+
+  std::vector<Buffer> m_free;
+  std::vector<Buffer> m_used;
+
+  BlockBuffers(const BlockBuffers &);
+  BlockBuffers &operator=(const BlockBuffers &);
+};
+
+
+#endif
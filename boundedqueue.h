@@ -0,0 +1,82 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <deque>
+
+
+//! Blocking queue of at most capacity items, handing work from one thread to another
+// A producer waits while it is full and a consumer while it is empty, so
+// the items in flight, and the memory behind them, stay bounded. close()
+// wakes both sides: push() then refuses new items and pop() returns what is
+// left before it reports the end.
+template <typename T>
+class BoundedQueue {
+ public:
+  BoundedQueue(size_t capacity) : m_capacity(capacity), m_closed(false) {
+    pthread_mutex_init(&m_mutex, 0);
+    pthread_cond_init(&m_notFull, 0);
+    pthread_cond_init(&m_notEmpty, 0);
+  }
+
+  ~BoundedQueue() {
+    pthread_cond_destroy(&m_notEmpty);
+    pthread_cond_destroy(&m_notFull);
+    pthread_mutex_destroy(&m_mutex);
+  }
+
+  //false, and the item not queued, once the queue is closed
+  bool push(const T &item) {
+    pthread_mutex_lock(&m_mutex);
+    while (!m_closed && m_items.size() >= m_capacity)
+      pthread_cond_wait(&m_notFull, &m_mutex);
+    bool queued = !m_closed;
+    if (queued)
+      m_items.push_back(item);
+    pthread_cond_signal(&m_notEmpty);
+    pthread_mutex_unlock(&m_mutex);
+    return queued;
+  }
+
+  //false once the queue is closed and empty
+  bool pop(T *item) {
+    pthread_mutex_lock(&m_mutex);
+    while (!m_closed && m_items.empty())
+      pthread_cond_wait(&m_notEmpty, &m_mutex);
+    bool found = !m_items.empty();
+    if (found) {
+      *item = m_items.front();
+      m_items.pop_front();
+    }
+    pthread_cond_signal(&m_notFull);
+    pthread_mutex_unlock(&m_mutex);
+    return found;
+  }
+
+  void close() {
+    pthread_mutex_lock(&m_mutex);
+    m_closed = true;
+    pthread_cond_broadcast(&m_notFull);
+    pthread_cond_broadcast(&m_notEmpty);
+    pthread_mutex_unlock(&m_mutex);
+  }
+
+ private:
+  size_t m_capacity;
+  bool m_closed;
+  std::deque<T> m_items;
+
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_notFull;
+  pthread_cond_t m_notEmpty;
+
+  BoundedQueue(const BoundedQueue &);
+  BoundedQueue &operator=(const BoundedQueue &);
+};
+
+
+#endif
@@ -0,0 +1,206 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <string.h>
+#include <limits.h>
+
+#include "bytesource.h"
+#include "bgzfsource.h"
+#include "speculativegzip.h"
+
+
+#define GZIP_INPUT_SIZE (1 << 20)
+
+
+static bool readMagic(unsigned char *header, size_t n, const char *file)
+{
+  FILE *fptr = fopen(file, "rb");
+  if (0 == fptr) {
+    fprintf(stderr, "ERROR cannot open %s\n", file);
+    return false;
+  }
+  memset(header, 0, n);
+  fread(header, 1, n, fptr);
+  fclose(fptr);
+  return true;
+}
+
+
+static bool isGzip(const unsigned char *header)
+{
+  return 0x1f == header[0] && 0x8b == header[1];
+}
+
+
+bool ByteSource::isCompressed(const char *file)
+{
+  unsigned char header[BGZF_HEADER_SIZE];
+  return readMagic(header, BGZF_HEADER_SIZE, file) && isGzip(header);
+}
+
+
+ByteSource *ByteSource::create(const char *file, size_t threads)
+{
+  unsigned char header[BGZF_HEADER_SIZE];
+  if (!readMagic(header, BGZF_HEADER_SIZE, file))
+    return 0;
+
+  if (BgzfSource::isBgzf(header)) {
+    BgzfSource *source = new BgzfSource(threads);
+    if (!source->open(file)) {
+      delete source;
+      return 0;
+    }
+    printf("reading bgzf input with %zu threads\n", threads);
+    return source;
+  }
+
+  if (isGzip(header) && threads > 1) {
+    SpeculativeGzipSource *source = new SpeculativeGzipSource(threads);
+    if (!source->open(file)) {
+      delete source;
+      return 0;
+    }
+    printf("reading gzip input with %zu threads (speculative inflate)\n", threads);
+    return source;
+  }
+
+  if (isGzip(header)) {
+    GzipSource *source = new GzipSource;
+    if (!source->open(file)) {
+      delete source;
+      return 0;
+    }
+    printf("reading gzip input\n");
+    return source;
+  }
+
+  FileSource *source = new FileSource;
+  if (!source->open(file)) {
+    delete source;
+    return 0;
+  }
+  return source;
+}
+
+
+
+
+FileSource::FileSource()
+{
+  m_fptr = 0;
+  m_failed = false;
+}
+
+
+FileSource::~FileSource()
+{
+  if (0 != m_fptr)
+    fclose(m_fptr);
+}
+
+
+bool FileSource::open(const char *file)
+{
+  m_fptr = fopen(file, "rb");
+  if (0 == m_fptr) {
+    fprintf(stderr, "ERROR cannot open %s\n", file);
+    return false;
+  }
+  return true;
+}
+
+
+size_t FileSource::read(char *buffer, size_t n)
+{
+  size_t count = fread(buffer, 1, n, m_fptr);
+  if (0 == count && ferror(m_fptr)) {
+    fprintf(stderr, "ERROR failed reading input\n");
+    m_failed = true;
+  }
+  return count;
+}
+
+
+
+
+GzipSource::GzipSource()
+{
+  m_fptr = 0;
+  m_input = 0;
+  m_streamEnd = false;
+  m_failed = false;
+  memset(&m_stream, 0, sizeof(m_stream));
+}
+
+
+GzipSource::~GzipSource()
+{
+  if (0 != m_fptr) {
+    fclose(m_fptr);
+    inflateEnd(&m_stream);
+  }
+  delete[] m_input;
+}
+
+
+bool GzipSource::open(const char *file)
+{
+  m_fptr = fopen(file, "rb");
+  if (0 == m_fptr) {
+    fprintf(stderr, "ERROR cannot open %s\n", file);
+    return false;
+  }
+
+  if (Z_OK != inflateInit2(&m_stream, 15 + 16)) {  //gzip wrapper
+    fprintf(stderr, "ERROR could not initialize zlib for %s\n", file);
+    fclose(m_fptr);
+    m_fptr = 0;
+    return false;
+  }
+  m_input = new unsigned char[GZIP_INPUT_SIZE];
+  return true;
+}
+
+
+size_t GzipSource::read(char *buffer, size_t n)
+{
+  if (m_failed)
+    return 0;
+
+  if (n > UINT_MAX)
+    n = UINT_MAX;
+  m_stream.next_out = (Bytef *) buffer;
+  m_stream.avail_out = n;
+
+  while (m_stream.avail_out > 0) {
+    if (0 == m_stream.avail_in) {
+      size_t count = fread(m_input, 1, GZIP_INPUT_SIZE, m_fptr);
+      if (0 == count) {
+        if (ferror(m_fptr) || !m_streamEnd) {
+          fprintf(stderr, "ERROR gzip input is truncated or unreadable\n");
+          m_failed = true;
+        }
+        break;
+      }
+      m_stream.next_in = m_input;
+      m_stream.avail_in = count;
+    }
+
+    if (m_streamEnd) {  //another gzip member follows
+      inflateReset(&m_stream);
+      m_streamEnd = false;
+    }
+
+    int ret = inflate(&m_stream, Z_NO_FLUSH);
+    if (Z_STREAM_END == ret) {
+      m_streamEnd = true;
+    }
+    else if (Z_OK != ret) {
+      fprintf(stderr, "ERROR could not inflate gzip input (zlib error %i)\n", ret);
+      m_failed = true;
+      break;
+    }
+  }
+
+  return n - m_stream.avail_out;
+}
@@ -0,0 +1,65 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef BYTESOURCE_H
+#define BYTESOURCE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <zlib.h>
+
+
+//! Sequential stream of (decompressed) input bytes
+class ByteSource {
+ public:
+  virtual ~ByteSource() { }
+
+  //fills up to n bytes, returns 0 at end of input or on error
+  virtual size_t read(char *buffer, size_t n)=0;
+  virtual bool failed() const=0;
+
+  //picks plain, gzip or bgzf from the first bytes of the file, 0 on error
+  static ByteSource *create(const char *file, size_t threads);
+  static bool isCompressed(const char *file);
+};
+
+
+
+//! Uncompressed file
+class FileSource : public ByteSource {
+ public:
+  FileSource();
+  ~FileSource();
+
+  bool open(const char *file);
+  size_t read(char *buffer, size_t n);
+  bool failed() const { return m_failed; }
+
+ private:
+  FILE *m_fptr;
+  bool m_failed;
+};
+
+
+
+//! Gzip file inflated as one stream on the calling thread, concatenated members are followed
+class GzipSource : public ByteSource {
+ public:
+  GzipSource();
+  ~GzipSource();
+
+  bool open(const char *file);
+  size_t read(char *buffer, size_t n);
+  bool failed() const { return m_failed; }
+
+ private:
+  FILE *m_fptr;
+  z_stream m_stream;
+  unsigned char *m_input;
+  bool m_streamEnd;
+  bool m_failed;
+};
+
+
+#endif
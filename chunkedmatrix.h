@@ -0,0 +1,85 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef CHUNKEDMATRIX_H
+#define CHUNKEDMATRIX_H
+
+#include <string.h>
+#include <vector>
+
+
+#define CHUNK_BYTES (4 << 20)
+
+
+//! Row major matrix that grows by whole chunks of rows
+// Used where the number of rows is not known until the input has been read,
+// growing never moves existing rows, so no reallocation or copy is needed.
+template <typename T>
+class ChunkedMatrix {
+ public:
+  ChunkedMatrix() : m_rows(0), m_cols(0), m_chunkRows(1) { }
+  ~ChunkedMatrix() { clear(); }
+
+  //drops all rows and sets the number of columns
+  void reset(size_t cols) {
+    clear();
+    m_cols = cols;
+    m_chunkRows = CHUNK_BYTES / (cols * sizeof(T) + 1);
+    if (m_chunkRows < 1)
+      m_chunkRows = 1;
+  }
+
+  //new rows are zero filled, shrinking releases chunks no longer needed
+  void resize(size_t rows) {
+    size_t chunks = (rows + m_chunkRows - 1) / m_chunkRows;
+    while (m_chunks.size() > chunks) {
+      delete[] m_chunks.back();
+      m_chunks.pop_back();
+    }
+    while (m_chunks.size() < chunks) {
+      size_t n = m_chunkRows * m_cols;
+      T *chunk = new T[n];
+      memset(chunk, 0, n * sizeof(T));
+      m_chunks.push_back(chunk);
+    }
+    m_rows = rows;
+  }
+
+  //frees the chunks that only hold rows below rows, for a matrix copied out
+  //front to back; those rows must not be used again before clear()
+  void release(size_t rows) {
+    for (size_t c = rows / m_chunkRows; c-- > 0 && 0 != m_chunks[c]; ) {
+      delete[] m_chunks[c];
+      m_chunks[c] = 0;
+    }
+  }
+
+  void clear() {
+    for (size_t i = 0; i < m_chunks.size(); i++)
+      delete[] m_chunks[i];
+    m_chunks.clear();
+    m_rows = 0;
+  }
+
+  size_t rows() const { return m_rows; }
+  size_t cols() const { return m_cols; }
+
+  T &operator()(size_t i, size_t k) { return m_chunks[i / m_chunkRows][ (i % m_chunkRows) * m_cols + k ]; }
+  const T &operator()(size_t i, size_t k) const { return m_chunks[i / m_chunkRows][ (i % m_chunkRows) * m_cols + k ]; }
+
+  //contiguous storage for one row
+  T *row(size_t i) { return m_chunks[i / m_chunkRows] + (i % m_chunkRows) * m_cols; }
+  const T *row(size_t i) const { return m_chunks[i / m_chunkRows] + (i % m_chunkRows) * m_cols; }
+
+ private:
+  size_t m_rows;
+  size_t m_cols;
+  size_t m_chunkRows;
+  std::vector<T*> m_chunks;
+
+  ChunkedMatrix(const ChunkedMatrix &);
+  ChunkedMatrix &operator=(const ChunkedMatrix &);
+};
+
+
+#endif
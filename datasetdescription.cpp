@@ -7,6 +7,10 @@
 
 #include "sspt_list.h"
 
+#ifdef HAVE_NC_FILTERS
+#include "netcdf_filter.h"
+#endif
+
 struct DimensionDesc {
   char name[NC_MAX_NAME+1];
   size_t size;
@@ -21,6 +25,15 @@ struct VariableDesc {
 };
 
 
+struct StorageRule {
+  sspt_Cord prefix;
+  size_t length;
+  bool exact;  //the whole name, not a prefix
+  sspt_Cord exclude;  //variable name, "" for none
+  VariableStorage storage;
+};
+
+
 
 DataSetDescription::DataSetDescription()
 {
@@ -30,6 +43,8 @@ DataSetDescription::DataSetDescription()
 DataSetDescription::~DataSetDescription()
 {
   //TODO free memory
+  for (size_t i = 0; i < m_storage.size(); i++)
+    delete m_storage[i];
 }
 
 
@@ -96,6 +111,47 @@ bool DataSetDescription::addVariable(const char *varname, nc_type xtype, const c
 
 
 
+bool DataSetDescription::addAttribute(const char *name, const char *value)
+{
+  sspt_Cord key(name);
+  if (!m_attributes.find(key, 0))
+    m_attributes.insert(key, sspt_Cord(value));
+  return true;
+}
+
+
+
+void DataSetDescription::storage(const char *prefix, const VariableStorage &storage, bool exact, const char *exclude)
+{
+  StorageRule *rule = new StorageRule;
+  rule->prefix = prefix;
+  rule->length = strlen(prefix);
+  rule->exact = exact;
+  rule->exclude = (0 == exclude) ? "" : exclude;
+  rule->storage = storage;
+  m_storage.push_back(rule);
+}
+
+
+const VariableStorage *DataSetDescription::findStorage(const char *varname) const
+{
+  const StorageRule *best = 0;
+  for (size_t i = 0; i < m_storage.size(); i++) {
+    const StorageRule *rule = m_storage[i];
+    if (0 != strncmp(varname, rule->prefix.c_str(), rule->length))
+      continue;
+    if (rule->exact && 0 != varname[rule->length])
+      continue;
+    if (0 == strcmp(varname, rule->exclude.c_str()))
+      continue;
+    if (0 == best || rule->length >= best->length)
+      best = rule;
+  }
+  return (0 == best) ? 0 : &best->storage;
+}
+
+
+
 bool DataSetDescription::reviseDimensionSize(const char *name, size_t revisedSize)
 {
   sspt_Cord dname(name);
@@ -112,6 +168,51 @@ bool DataSetDescription::reviseDimensionSize(const char *name, size_t revisedSiz
 
 
 
+// chunking and compression of a variable just defined; strings, NC_STRING
+// as well as the NC_CHAR ones padded to string_position, and scalars are
+// left as they are
+static bool defineStorage(int ncid, int varid, const VariableDesc *v, const VariableStorage &storage)
+{
+  int nret;
+  size_t nDims = v->dims.size();
+  if (NC_STRING == v->xtype || NC_CHAR == v->xtype || 0 == nDims)
+    return true;
+
+  if (storage.nChunks > 0) {
+    if (storage.nChunks > nDims) {
+      fprintf(stderr, "ERROR %zu chunk sizes given for %s, which has %zu dimensions\n", storage.nChunks, v->name, nDims);
+      return false;
+    }
+    size_t chunks[STORAGE_MAX_DIMS];
+    for (size_t k = 0; k < nDims; k++) {
+      size_t size = (v->dims[k]->size > 0) ? v->dims[k]->size : 1;
+      chunks[k] = (k < storage.nChunks && storage.chunks[k] < size) ? storage.chunks[k] : size;
+    }
+    nret = nc_def_var_chunking(ncid, varid, NC_CHUNKED, chunks);
+    FALSE_ON_NETCDF_ERROR(nret, "ERROR failed to set the chunks of %s", v->name);
+  }
+
+  if (storage.deflate > 0 || storage.shuffle) {
+    nret = nc_def_var_deflate(ncid, varid, storage.shuffle ? NC_SHUFFLE : 0, storage.deflate > 0, storage.deflate);
+    FALSE_ON_NETCDF_ERROR(nret, "ERROR failed to set the compression of %s", v->name);
+  }
+
+  if (0 != storage.filter) {
+#ifdef HAVE_NC_FILTERS
+    const unsigned int *params = storage.filterParams.empty() ? 0 : &storage.filterParams[0];
+    nret = nc_def_var_filter(ncid, varid, storage.filter, storage.filterParams.size(), params);
+    FALSE_ON_NETCDF_ERROR(nret, "ERROR failed to set filter %u on %s", storage.filter, v->name);
+#else
+    fprintf(stderr, "ERROR filter %u requested for %s, this build has no filter support (HAVE_NC_FILTERS)\n",
+            storage.filter, v->name);
+    return false;
+#endif
+  }
+  return true;
+}
+
+
+
 bool DataSetDescription::createEmptyNetCDF(int *ncid, const char *file)
 {
   sspt_AVLTree<sspt_Cord,int> dimensionIndex;
@@ -165,6 +266,17 @@ bool DataSetDescription::createEmptyNetCDF(int *ncid, const char *file)
     nret = nc_def_var(*ncid, v->name, v->xtype, v->dims.size(), dims, &var);
     FALSE_ON_NETCDF_ERROR(nret, "ERROR failed to create %s variable\n", v->name);
     delete[] dims;
+
+    const VariableStorage *storage = findStorage(v->name);
+    if (0 != storage && !defineStorage(*ncid, var, v, *storage))
+      return false;
+  }
+
+  for (sspt_AVLIterator<sspt_Cord,sspt_Cord> iter = m_attributes.begin();
+       !iter.atEnd(); iter.moveNext()) {
+    sspt_Cord value = iter.data();
+    nret = nc_put_att_text(*ncid, NC_GLOBAL, iter.key().c_str(), strlen(value.c_str()), value.c_str());
+    FALSE_ON_NETCDF_ERROR(nret, "ERROR failed to create %s attribute\n", iter.key().c_str());
   }
 
   ncendef(*ncid);
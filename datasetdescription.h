@@ -9,10 +9,14 @@
 #include "sspt_cord.h"
 #include "sspt_avltree.h"
 #include "utilsnetcdf.h"
+#include "variablestorage.h"
+
+#include <vector>
 
 
 struct DimensionDesc;
 struct VariableDesc;
+struct StorageRule;
 
 
 class DataSetDescription {
@@ -25,6 +29,12 @@ public:
   bool addDimension(const char *dimname, size_t size);
   //add a variable with known dimensions
   bool addVariable(const char *varname, nc_type xtype, const char *dim1, const char *dim2=0, const char *dim3=0);
+  //global text attribute, idempotent like addDimension, the first value is kept
+  bool addAttribute(const char *name, const char *value);
+  //chunking and compression of the variables whose names start with prefix,
+  //"" for all, or of the one named so if exact, except the one named exclude;
+  //the longest matching name decides, the later one on a tie
+  void storage(const char *prefix, const VariableStorage &storage, bool exact=false, const char *exclude=0);
 
 
   bool reviseDimensionSize(const char *dimension, size_t revisedSize);
@@ -36,6 +46,10 @@ public:
 private:
   sspt_AVLTree<sspt_Cord, VariableDesc*> m_vars;
   sspt_AVLTree<sspt_Cord, DimensionDesc*> m_dims;
+  sspt_AVLTree<sspt_Cord, sspt_Cord> m_attributes;
+  std::vector<StorageRule*> m_storage;
+
+  const VariableStorage *findStorage(const char *varname) const;
 
 };
 
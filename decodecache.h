@@ -0,0 +1,61 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef DECODECACHE_H
+#define DECODECACHE_H
+
+#include <stdint.h>
+#include <vector>
+
+
+#define DECODE_CACHE_SLOTS (1 << 16)  //at most, fewer when there are fewer string ids
+#define DECODE_CACHE_BYTES (1 << 22)  //at most, fewer slots when they are wide
+
+
+//! Direct mapped cache of values decoded from interned sample strings
+// Keyed by string id and the subfield taken from it, as the same string
+// decodes differently under another FORMAT layout. Cohorts repeat a few
+// strings like 0/0:30:99 over and over, so most cells find their values
+// here and only copy them. Each worker keeps its own, so there is no
+// locking; when every id has its own slot nothing is decoded twice.
+template <typename T>
+class DecodeCache {
+ public:
+  //slots, ids and values together in maxBytes, but at least one slot
+  DecodeCache(size_t width, uint64_t idLimit, size_t maxBytes) : m_width(width) {
+    size_t slotBytes = width * sizeof(T) + sizeof(uint32_t) + sizeof(int);
+    size_t slots = 1;
+    while (slots < idLimit && slots < DECODE_CACHE_SLOTS && 2 * slots * slotBytes <= maxBytes)
+      slots <<= 1;
+    m_mask = slots - 1;
+    m_ids.resize(slots);
+    m_subfields.assign(slots, -1);
+    m_values.resize(slots * width);
+  }
+
+  //width values of id at subfield, 0 if they are not cached
+  const T *find(uint32_t id, int subfield) const {
+    size_t slot = id & m_mask;
+    if (m_subfields[slot] != subfield || m_ids[slot] != id)
+      return 0;
+    return &m_values[slot * m_width];
+  }
+
+  //slot for the width values of id at subfield, replacing what was there
+  T *insert(uint32_t id, int subfield) {
+    size_t slot = id & m_mask;
+    m_ids[slot] = id;
+    m_subfields[slot] = subfield;
+    return &m_values[slot * m_width];
+  }
+
+ private:
+  size_t m_width;
+  size_t m_mask;
+  std::vector<uint32_t> m_ids;
+  std::vector<int> m_subfields;  //-1 for empty slots
+  std::vector<T> m_values;
+};
+
+
+#endif
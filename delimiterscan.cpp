@@ -0,0 +1,176 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && !defined(NO_SIMD_SCAN)
+#define SIMD_SCAN
+#include <immintrin.h>
+#endif
+
+#include "delimiterscan.h"
+
+
+// The delimiters of a line are found a vector at a time: the bytes are
+// compared against every delimiter, the matches folded into a bit mask, and
+// a field ends at every set bit.  The AVX2 kernel is compiled for that
+// target only and picked when the cpu has it, SSE2 is part of x86-64.  The
+// kernels are instantiated per number of delimiters so the compare loop
+// unrolls.
+
+
+typedef void (*SplitKernel)(const char *text, size_t length, const char *delimiters, std::vector<TextView> *fields);
+
+
+// fields ending at a delimiter in [p, end), begin is the start of the current field
+template <int N>
+static inline void scanBytes(const char *p, const char *end, const char *delimiters, const char **begin, std::vector<TextView> *fields)
+{
+  if (1 == N) {
+    while (true) {
+      const char *found = (const char *) memchr(p, delimiters[0], end - p);
+      if (0 == found)
+        break;
+      fields->push_back( TextView(*begin, found - *begin) );
+      *begin = p = found + 1;
+    }
+    return;
+  }
+
+  for (; p < end; p++) {
+    for (int k = 0; k < N; k++) {
+      if (delimiters[k] == *p) {
+        fields->push_back( TextView(*begin, p - *begin) );
+        *begin = p + 1;
+        break;
+      }
+    }
+  }
+}
+
+
+template <int N>
+static void splitScalar(const char *text, size_t length, const char *delimiters, std::vector<TextView> *fields)
+{
+  const char *begin = text;
+  scanBytes<N>(text, text + length, delimiters, &begin, fields);
+  fields->push_back( TextView(begin, text + length - begin) );
+}
+
+
+#ifdef SIMD_SCAN
+
+static inline void maskFields(unsigned int mask, const char *block, const char **begin, std::vector<TextView> *fields)
+{
+  while (0 != mask) {
+    const char *p = block + __builtin_ctz(mask);
+    fields->push_back( TextView(*begin, p - *begin) );
+    *begin = p + 1;
+    mask &= mask - 1;
+  }
+}
+
+
+template <int N>
+static void splitSSE2(const char *text, size_t length, const char *delimiters, std::vector<TextView> *fields)
+{
+  __m128i d[N];
+  for (int k = 0; k < N; k++)
+    d[k] = _mm_set1_epi8(delimiters[k]);
+
+  const char *begin = text;
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *) (text + i));
+    __m128i match = _mm_cmpeq_epi8(v, d[0]);
+    for (int k = 1; k < N; k++)
+      match = _mm_or_si128(match, _mm_cmpeq_epi8(v, d[k]));
+    maskFields(_mm_movemask_epi8(match), text + i, &begin, fields);
+  }
+
+  scanBytes<N>(text + i, text + length, delimiters, &begin, fields);
+  fields->push_back( TextView(begin, text + length - begin) );
+}
+
+
+template <int N>
+__attribute__((target("avx2")))
+static void splitAVX2(const char *text, size_t length, const char *delimiters, std::vector<TextView> *fields)
+{
+  __m256i d[N];
+  for (int k = 0; k < N; k++)
+    d[k] = _mm256_set1_epi8(delimiters[k]);
+
+  const char *begin = text;
+  size_t i = 0;
+  for (; i + 32 <= length; i += 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *) (text + i));
+    __m256i match = _mm256_cmpeq_epi8(v, d[0]);
+    for (int k = 1; k < N; k++)
+      match = _mm256_or_si256(match, _mm256_cmpeq_epi8(v, d[k]));
+    maskFields(_mm256_movemask_epi8(match), text + i, &begin, fields);
+  }
+
+  scanBytes<N>(text + i, text + length, delimiters, &begin, fields);
+  fields->push_back( TextView(begin, text + length - begin) );
+}
+
+#endif
+
+
+
+struct KernelSet {
+  const char *isa;
+  SplitKernel split[DELIMITER_SET_MAX];  //by number of delimiters - 1
+};
+
+
+static KernelSet selectKernels()
+{
+#ifdef SIMD_SCAN
+#ifndef NO_AVX2_SCAN
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    KernelSet set = { "avx2", { splitAVX2<1>, splitAVX2<2>, splitAVX2<3>, splitAVX2<4> } };
+    return set;
+  }
+#endif
+  KernelSet set = { "sse2", { splitSSE2<1>, splitSSE2<2>, splitSSE2<3>, splitSSE2<4> } };
+  return set;
+#else
+  KernelSet set = { "scalar", { splitScalar<1>, splitScalar<2>, splitScalar<3>, splitScalar<4> } };
+  return set;
+#endif
+}
+
+
+static const KernelSet s_kernels = selectKernels();  //before main, so before any worker thread
+
+
+
+size_t splitViewAny(const TextView &text, const char *delimiters, std::vector<TextView> *fields)
+{
+  fields->clear();
+  size_t n = strlen(delimiters);
+  if (0 == n) {
+    fields->push_back(text);
+    return 1;
+  }
+  if (n > DELIMITER_SET_MAX)
+    n = DELIMITER_SET_MAX;
+  s_kernels.split[n-1](text.ptr, text.length, delimiters, fields);
+  return fields->size();
+}
+
+
+size_t splitView(const TextView &text, char delimiter, std::vector<TextView> *fields)
+{
+  fields->clear();
+  s_kernels.split[0](text.ptr, text.length, &delimiter, fields);
+  return fields->size();
+}
+
+
+const char *delimiterScanISA()
+{
+  return s_kernels.isa;
+}
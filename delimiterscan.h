@@ -0,0 +1,27 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef DELIMITERSCAN_H
+#define DELIMITERSCAN_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "textview.h"
+
+
+#define DELIMITER_SET_MAX 4
+
+
+//split like sspt_DelimiterParse(text, delimiter, false), empty fields are kept
+size_t splitView(const TextView &text, char delimiter, std::vector<TextView> *fields);
+
+//split at every byte that is one of the (at most DELIMITER_SET_MAX) delimiters, in
+//one pass; the delimiter that ended field i < size-1 is fields[i].ptr[fields[i].length]
+size_t splitViewAny(const TextView &text, const char *delimiters, std::vector<TextView> *fields);
+
+//instruction set the scan was built for on this cpu, "avx2", "sse2" or "scalar"
+const char *delimiterScanISA();
+
+
+#endif
@@ -0,0 +1,248 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "formatcolumns.h"
+#include "delimiterscan.h"
+#include "numberparse.h"
+#include "genotypecodes.h"
+
+
+FormatColumns::FormatColumns() : m_samples(0)
+{
+  pthread_mutex_init(&m_lock, 0);
+}
+
+
+FormatColumns::~FormatColumns()
+{
+  for (size_t i = 0; i < m_columns.size(); i++)
+    delete m_columns[i];
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+
+// same kinds and value counts as VCF40FieldTranslator::addFormatVar() gives the variables
+bool FormatColumns::declare(const std::string &key, const std::string &vtype, const std::string &number)
+{
+  int n = atoi(number.c_str());
+  if (-1 == n && "PL" == key)  //same workaround as the translator, three likelihoods
+    n = 3;
+
+  Column *column = new Column;
+  if (vtype == "Integer")
+    column->kind = FORMAT_INT;
+  else if (vtype == "Float")
+    column->kind = FORMAT_DOUBLE;
+  else if (vtype == "String" && key == "GT") {
+    column->kind = FORMAT_GT;
+    n = GT_CODE_WIDTH;
+  }
+  else
+    n = -1;
+
+  if (n < 0) {
+    delete column;
+    return false;
+  }
+  column->key = key;
+  column->factor = (n > 1) ? n : 1;
+  column->overflowSNP = FORMAT_NO_OVERFLOW;
+  column->overflowValues = 0;
+  column->shortFields = 0;
+
+  size_t i = 0;
+  while (i < m_columns.size() && m_columns[i]->key < key)
+    i++;
+  if (i < m_columns.size() && m_columns[i]->key == key) {  //declared twice, the last one stands like the variable table
+    delete m_columns[i];
+    m_columns[i] = column;
+  }
+  else
+    m_columns.insert(m_columns.begin() + i, column);
+  return true;
+}
+
+
+void FormatColumns::reset(size_t samples)
+{
+  m_samples = samples;
+  for (size_t i = 0; i < m_columns.size(); i++) {
+    Column *column = m_columns[i];
+    size_t cols = samples * column->factor;
+    if (FORMAT_INT == column->kind)
+      column->ints.reset(cols);
+    else if (FORMAT_DOUBLE == column->kind)
+      column->doubles.reset(cols);
+    else
+      column->genotypes.reset(cols);
+  }
+}
+
+
+void FormatColumns::resize(size_t snps)
+{
+  for (size_t i = 0; i < m_columns.size(); i++) {
+    Column *column = m_columns[i];
+    if (FORMAT_INT == column->kind)
+      column->ints.resize(snps);
+    else if (FORMAT_DOUBLE == column->kind)
+      column->doubles.resize(snps);
+    else
+      column->genotypes.resize(snps);
+  }
+}
+
+
+
+const FormatColumns::Column *FormatColumns::find(const char *key) const
+{
+  for (size_t i = 0; i < m_columns.size(); i++) {
+    if (m_columns[i]->key == key)
+      return m_columns[i];
+  }
+  return 0;
+}
+
+
+// the first occurrence of a key counts, as in the converter's search of the FORMAT fields
+void FormatColumns::layout(const TextView &format, std::vector<int> *subfields, std::vector<TextView> *scratch) const
+{
+  subfields->assign(m_columns.size(), -1);
+  size_t n = splitView(format, ':', scratch);
+  for (size_t j = 0; j < n; j++) {
+    const TextView &key = (*scratch)[j];
+    size_t low = 0;
+    size_t high = m_columns.size();
+    while (low < high) {
+      size_t middle = (low + high) / 2;
+      int c = key.compare(m_columns[middle]->key.data(), m_columns[middle]->key.size());
+      if (c > 0)
+        low = middle + 1;
+      else if (c < 0)
+        high = middle;
+      else {
+        if (-1 == (*subfields)[middle])
+          (*subfields)[middle] = j;
+        break;
+      }
+    }
+  }
+}
+
+
+
+static inline void parseNumber(const TextView &text, int *value) { parseInt(text, value); }
+static inline void parseNumber(const TextView &text, double *value) { parseDouble(text, value); }
+
+
+// comma separated values of one sample into out[0, factor), 0 for the ones
+// not given; returns the number of values found
+template <typename T>
+static size_t decodeValues(T *out, size_t factor, const TextView &text)
+{
+  if (1 == factor) {  //a single value reads the whole text
+    parseNumber(text, &out[0]);
+    return 1;
+  }
+
+  size_t values = 0;
+  const char *end = text.ptr + text.length;
+  for (const char *p = text.ptr; ; values++) {
+    const char *comma = (const char *) memchr(p, ',', end - p);
+    if (values < factor)
+      parseNumber(TextView(p, ((0 != comma) ? comma : end) - p), &out[values]);
+    if (0 == comma)
+      break;
+    p = comma + 1;
+  }
+  values++;
+
+  for (size_t m = values; m < factor; m++)
+    out[m] = 0;
+  return values;
+}
+
+
+void FormatColumns::decode(Column *column, size_t snp, size_t sample, const TextView &entry, size_t *shortFields)
+{
+  size_t factor = column->factor;
+
+  if (FORMAT_GT == column->kind) {  //characters only, store() translates the row
+    if (gatherGenotype(entry, column->genotypes.row(snp) + sample * factor))
+      (*shortFields)++;
+    return;
+  }
+
+  size_t values;
+  if (FORMAT_INT == column->kind)
+    values = decodeValues(column->ints.row(snp) + sample * factor, factor, entry);
+  else
+    values = decodeValues(column->doubles.row(snp) + sample * factor, factor, entry);
+
+  if (values > factor) {  //reported when the variable is written, the first snp in file order
+    pthread_mutex_lock(&m_lock);
+    if (snp < column->overflowSNP) {
+      column->overflowSNP = snp;
+      column->overflowValues = values;
+    }
+    pthread_mutex_unlock(&m_lock);
+  }
+}
+
+
+template <typename T>
+static inline void fillMissing(T *out, size_t factor)
+{
+  for (size_t m = 0; m < factor; m++)
+    out[m] = -1;
+}
+
+
+void FormatColumns::store(size_t snp, const TextView *samples, size_t first, size_t last, const std::vector<int> &subfields,
+                          std::vector<TextView> *fields)
+{
+  Column *genotype = 0;
+  size_t shortFields = 0;
+
+  for (size_t k = first; k < last; k++) {
+    splitView(samples[k], ':', fields);
+
+    //special case of empty data, v3.3 apparently used empty string
+    bool missing = 1 == fields->size() && ((*fields)[0].equals("./.") || 0 == (*fields)[0].length);
+
+    for (size_t c = 0; c < m_columns.size(); c++) {
+      Column *column = m_columns[c];
+      int subfield = subfields[c];
+
+      if (FORMAT_GT == column->kind) {
+        if (-1 == subfield)  //the conversion stops on a snp without GT
+          continue;
+        genotype = column;
+      }
+      else if (-1 == subfield || missing) {
+        if (FORMAT_INT == column->kind)
+          fillMissing(column->ints.row(snp) + k * column->factor, column->factor);
+        else
+          fillMissing(column->doubles.row(snp) + k * column->factor, column->factor);
+        continue;
+      }
+
+      //trailing fields may be left out of a sample, those read as empty
+      TextView entry = ((size_t) subfield < fields->size()) ? (*fields)[subfield] : TextView("", 0);
+      decode(column, snp, k, entry, &shortFields);
+    }
+  }
+
+  if (0 != genotype)
+    translateGenotypes(genotype->genotypes.row(snp) + first * GT_CODE_WIDTH, (last - first) * GT_CODE_WIDTH);
+
+  if (shortFields > 0) {
+    pthread_mutex_lock(&m_lock);
+    genotype->shortFields += shortFields;
+    pthread_mutex_unlock(&m_lock);
+  }
+}
@@ -0,0 +1,75 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef FORMATCOLUMNS_H
+#define FORMATCOLUMNS_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "textview.h"
+#include "chunkedmatrix.h"
+#include "genotypecodes.h"
+
+
+#define FORMAT_NO_OVERFLOW ((size_t) -1)
+
+
+//! Declared FORMAT keys, decoded out of the sample columns while loading
+// Each key gets a snps x (samples * factor) matrix, filled a row at a time
+// as the lines are parsed, so each sample string is split once instead of
+// once per FORMAT variable and never kept. Values decode the way the
+// converter decoded the strings: Integer and Float as atoi or atof read them,
+// -1 for missing samples and for snps whose FORMAT lacks the key, and GT as
+// three GTTranslator codes.
+class FormatColumns {
+ public:
+  enum Kind { FORMAT_INT, FORMAT_DOUBLE, FORMAT_GT };
+
+  struct Column {
+    std::string key;
+    Kind kind;
+    size_t factor;  //values per sample
+    ChunkedMatrix<int> ints;
+    ChunkedMatrix<double> doubles;
+    ChunkedMatrix<signed char> genotypes;
+
+    size_t overflowSNP;  //first snp with a sample of more than factor values, FORMAT_NO_OVERFLOW if none
+    size_t overflowValues;
+    size_t shortFields;  //GT samples shorter than GT_CODE_WIDTH
+  };
+
+  FormatColumns();
+  ~FormatColumns();
+
+  //from a ##FORMAT declaration, before reset(); false if the key is not decoded
+  bool declare(const std::string &key, const std::string &vtype, const std::string &number);
+  void reset(size_t samples);
+  void resize(size_t snps);
+
+  //subfield of each column in a FORMAT column text, -1 where it is absent
+  void layout(const TextView &format, std::vector<int> *subfields, std::vector<TextView> *scratch) const;
+
+  //decodes samples [first, last) of snp, samples points at the column of
+  //sample 0; different snps or sample ranges may be stored concurrently
+  void store(size_t snp, const TextView *samples, size_t first, size_t last, const std::vector<int> &subfields,
+             std::vector<TextView> *fields);
+
+  const Column *find(const char *key) const;
+  size_t size() const { return m_columns.size(); }
+
+ private:
+  std::vector<Column*> m_columns;  //sorted by key
+  size_t m_samples;
+  pthread_mutex_t m_lock;  //overflow records and short field counts
+
+  void decode(Column *column, size_t snp, size_t sample, const TextView &entry, size_t *shortFields);
+
+  FormatColumns(const FormatColumns &);
+  FormatColumns &operator=(const FormatColumns &);
+};
+
+
+#endif
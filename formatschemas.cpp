@@ -0,0 +1,60 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include "formatschemas.h"
+#include "delimiterscan.h"
+
+
+FormatSchemas::FormatSchemas() : m_keys(1)  //FORMAT_NO_SCHEMA
+{
+  pthread_mutex_init(&m_lock, 0);
+}
+
+
+FormatSchemas::~FormatSchemas()
+{
+  pthread_mutex_destroy(&m_lock);
+}
+
+
+
+uint32_t FormatSchemas::intern(const TextView &text, bool concurrent)
+{
+  std::string key = text.str();
+
+  if (concurrent)
+    pthread_mutex_lock(&m_lock);
+
+  uint32_t id;
+  std::map<std::string, uint32_t>::const_iterator iter = m_ids.find(key);
+  if (iter != m_ids.end())
+    id = iter->second;
+  else {
+    id = m_keys.size();
+    m_ids.insert(std::pair<std::string, uint32_t>(key, id));
+
+    std::vector<TextView> fields;
+    splitView(text, ':', &fields);
+    m_keys.push_back(std::vector<std::string>(fields.size()));
+    for (size_t j = 0; j < fields.size(); j++)
+      m_keys.back()[j] = fields[j].str();
+  }
+
+  if (concurrent)
+    pthread_mutex_unlock(&m_lock);
+  return id;
+}
+
+
+void FormatSchemas::subfields(const char *key, std::vector<int> *offsets) const
+{
+  offsets->assign(m_keys.size(), -1);
+  for (size_t id = 0; id < m_keys.size(); id++) {
+    const std::vector<std::string> &keys = m_keys[id];
+    for (size_t j = 0; j < keys.size(); j++) {
+      if (keys[j] == key) {
+        (*offsets)[id] = j;
+        break;
+      }
+    }
+  }
+}
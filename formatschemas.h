@@ -0,0 +1,48 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef FORMATSCHEMAS_H
+#define FORMATSCHEMAS_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "textview.h"
+
+
+#define FORMAT_NO_SCHEMA 0  //schema of rows without a FORMAT column, it has no keys
+
+
+//! Distinct FORMAT columns, each kept once as its list of keys
+// Nearly every row of a file repeats the same layout, GT:AD:DP:GQ:PL say,
+// so rows only keep a schema id. A variable resolves its key once per
+// schema with subfields(), after which finding the subfield of any row is
+// a lookup in that table.
+class FormatSchemas {
+ public:
+  FormatSchemas();
+  ~FormatSchemas();
+
+  //id of the FORMAT column text, the lock is only taken when concurrent
+  uint32_t intern(const TextView &text, bool concurrent=false);
+
+  const std::vector<std::string> &keys(uint32_t id) const { return m_keys[id]; }
+  size_t size() const { return m_keys.size(); }
+
+  //position of key in each schema, the first if it repeats, -1 where it is absent
+  void subfields(const char *key, std::vector<int> *offsets) const;
+
+ private:
+  std::vector< std::vector<std::string> > m_keys;
+  std::map<std::string, uint32_t> m_ids;  //by FORMAT column text
+  pthread_mutex_t m_lock;
+
+  FormatSchemas(const FormatSchemas &);
+  FormatSchemas &operator=(const FormatSchemas &);
+};
+
+
+#endif
@@ -0,0 +1,127 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && !defined(NO_SIMD_SCAN)
+#define SIMD_SCAN
+#include <immintrin.h>
+#endif
+
+#include "genotypecodes.h"
+
+
+// The codes are found without a branch per character: the digits are the
+// bytes whose distance from '0' is at most 9, the separators are matched
+// one each, and as they exclude each other the masked values are or-ed
+// together. The AVX2 kernel is picked when the cpu has it, as for the
+// delimiter scan.
+
+
+typedef void (*GenotypeKernel)(signed char *codes, size_t n);
+
+
+static inline signed char genotypeCode(signed char c)
+{
+  unsigned char d = (unsigned char) c - '0';
+  return (d < 10) ? d + 1 : ('|' == c) ? 1 : ('\\' == c) ? 2 : ('/' == c) ? 3 : 0;
+}
+
+
+static void translateScalar(signed char *codes, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    codes[i] = genotypeCode(codes[i]);
+}
+
+
+#ifdef SIMD_SCAN
+
+static void translateSSE2(signed char *codes, size_t n)
+{
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i nine = _mm_set1_epi8(9);
+  const __m128i one = _mm_set1_epi8(1);
+  const __m128i pipe = _mm_set1_epi8('|');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i slash = _mm_set1_epi8('/');
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i c = _mm_loadu_si128((const __m128i *) (codes + i));
+    __m128i d = _mm_sub_epi8(c, zero);
+    __m128i digit = _mm_cmpeq_epi8(_mm_min_epu8(d, nine), d);
+    __m128i code = _mm_and_si128(digit, _mm_add_epi8(d, one));
+    code = _mm_or_si128(code, _mm_and_si128(_mm_cmpeq_epi8(c, pipe), one));
+    code = _mm_or_si128(code, _mm_and_si128(_mm_cmpeq_epi8(c, backslash), _mm_set1_epi8(2)));
+    code = _mm_or_si128(code, _mm_and_si128(_mm_cmpeq_epi8(c, slash), _mm_set1_epi8(3)));
+    _mm_storeu_si128((__m128i *) (codes + i), code);
+  }
+  translateScalar(codes + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+static void translateAVX2(signed char *codes, size_t n)
+{
+  const __m256i zero = _mm256_set1_epi8('0');
+  const __m256i nine = _mm256_set1_epi8(9);
+  const __m256i one = _mm256_set1_epi8(1);
+  const __m256i pipe = _mm256_set1_epi8('|');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i slash = _mm256_set1_epi8('/');
+
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i c = _mm256_loadu_si256((const __m256i *) (codes + i));
+    __m256i d = _mm256_sub_epi8(c, zero);
+    __m256i digit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, nine), d);
+    __m256i code = _mm256_and_si256(digit, _mm256_add_epi8(d, one));
+    code = _mm256_or_si256(code, _mm256_and_si256(_mm256_cmpeq_epi8(c, pipe), one));
+    code = _mm256_or_si256(code, _mm256_and_si256(_mm256_cmpeq_epi8(c, backslash), _mm256_set1_epi8(2)));
+    code = _mm256_or_si256(code, _mm256_and_si256(_mm256_cmpeq_epi8(c, slash), _mm256_set1_epi8(3)));
+    _mm256_storeu_si256((__m256i *) (codes + i), code);
+  }
+  translateScalar(codes + i, n - i);
+}
+
+#endif
+
+
+
+struct GenotypeKernelChoice {
+  const char *isa;
+  GenotypeKernel translate;
+};
+
+
+static GenotypeKernelChoice selectKernel()
+{
+#ifdef SIMD_SCAN
+#ifndef NO_AVX2_SCAN
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    GenotypeKernelChoice choice = { "avx2", translateAVX2 };
+    return choice;
+  }
+#endif
+  GenotypeKernelChoice choice = { "sse2", translateSSE2 };
+  return choice;
+#else
+  GenotypeKernelChoice choice = { "scalar", translateScalar };
+  return choice;
+#endif
+}
+
+
+static const GenotypeKernelChoice s_kernel = selectKernel();  //before main, so before any worker thread
+
+
+
+void translateGenotypes(signed char *codes, size_t n)
+{
+  s_kernel.translate(codes, n);
+}
+
+
+const char *genotypeCodesISA()
+{
+  return s_kernel.isa;
+}
@@ -0,0 +1,41 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef GENOTYPECODES_H
+#define GENOTYPECODES_H
+
+#include <stddef.h>
+
+#include "textview.h"
+
+
+#define GT_CODE_WIDTH 3  //allele, phase, allele
+
+
+// GT fields are decoded in two steps: gatherGenotype() copies the three
+// characters of each call next to the others, and translateGenotypes() then
+// turns a whole run of them into the GTTranslator codes in place, a vector
+// of characters at a time: a digit d is d+1, '|' 1, '\\' 2, '/' 3 and
+// anything else, '.' included, 0.
+
+
+//the GT characters of entry into out, a short field is completed with
+//defaults: '' reads as "./." and a haploid call "a" as "a/."; true if it was short
+static inline bool gatherGenotype(const TextView &entry, signed char *out)
+{
+  size_t n = entry.length;
+  out[0] = (n > 0) ? entry.ptr[0] : '.';
+  out[1] = (n >= GT_CODE_WIDTH) ? entry.ptr[1] : '/';
+  out[2] = (n >= GT_CODE_WIDTH) ? entry.ptr[2] : '.';
+  return n < GT_CODE_WIDTH;
+}
+
+
+//gathered characters [0, n) of codes into their codes
+void translateGenotypes(signed char *codes, size_t n);
+
+//instruction set the translation was built for on this cpu, "avx2", "sse2" or "scalar"
+const char *genotypeCodesISA();
+
+
+#endif
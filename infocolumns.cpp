@@ -0,0 +1,144 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "infocolumns.h"
+#include "numberparse.h"
+
+
+InfoColumns::InfoColumns()
+{
+  pthread_mutex_init(&m_overflowLock, 0);
+}
+
+
+InfoColumns::~InfoColumns()
+{
+  pthread_mutex_destroy(&m_overflowLock);
+}
+
+
+
+// same types and value counts as VCF40FieldTranslator::addInfoVar() gives the variables
+bool InfoColumns::declare(const std::string &key, const std::string &vtype, const std::string &number)
+{
+  Column column;
+  if (vtype == "Integer")
+    column.isFloat = false;
+  else if (vtype == "Float")
+    column.isFloat = true;
+  else
+    return false;
+
+  int n = atoi(number.c_str());
+  if (n < 0)
+    return false;
+  column.factor = (n > 1) ? n : 1;
+  column.key = key;
+  column.overflowSNP = INFO_NO_OVERFLOW;
+  column.overflowValues = 0;
+
+  size_t i = 0;
+  while (i < m_columns.size() && m_columns[i].key < key)
+    i++;
+  if (i < m_columns.size() && m_columns[i].key == key)  //declared twice, the last one stands like the variable table
+    m_columns[i] = column;
+  else
+    m_columns.insert(m_columns.begin() + i, column);
+  return true;
+}
+
+
+void InfoColumns::resize(size_t snps)
+{
+  for (size_t i = 0; i < m_columns.size(); i++) {
+    Column &column = m_columns[i];
+    if (column.isFloat)
+      column.doubles.resize(snps * column.factor);
+    else
+      column.ints.resize(snps * column.factor);
+    column.present.resize((snps + 7) / 8);
+  }
+}
+
+
+
+InfoColumns::Column *InfoColumns::lookup(const TextView &key)
+{
+  size_t low = 0;
+  size_t high = m_columns.size();
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    int c = key.compare(m_columns[middle].key.data(), m_columns[middle].key.size());
+    if (0 == c)
+      return &m_columns[middle];
+    if (c > 0)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  return 0;
+}
+
+
+const InfoColumns::Column *InfoColumns::find(const char *key) const
+{
+  return const_cast<InfoColumns *>(this)->lookup(TextView(key, strlen(key)));
+}
+
+
+
+// keeps the first snp in file order, rows may be stored out of order
+void InfoColumns::overflow(Column *column, size_t snp, size_t values)
+{
+  pthread_mutex_lock(&m_overflowLock);
+  if (snp < column->overflowSNP) {
+    column->overflowSNP = snp;
+    column->overflowValues = values;
+  }
+  pthread_mutex_unlock(&m_overflowLock);
+}
+
+
+void InfoColumns::store(const TextView &key, const TextView &value, size_t snp)
+{
+  Column *column = lookup(key);
+  if (0 == column)
+    return;
+
+  //neighbouring snps share a byte and may be stored from other threads
+  unsigned char bit = 1 << (snp & 7);
+  if (__sync_fetch_and_or(&column->present[snp >> 3], bit) & bit)
+    return;
+
+  size_t offset = snp * column->factor;
+  if (1 == column->factor) {
+    if (column->isFloat)
+      parseDouble(value, &column->doubles[offset]);
+    else
+      parseInt(value, &column->ints[offset]);
+    return;
+  }
+
+  size_t values = 0;
+  const char *end = value.ptr + value.length;
+  for (const char *p = value.ptr; ; values++) {
+    const char *comma = (const char *) memchr(p, ',', end - p);
+    TextView item(p, ((0 != comma) ? comma : end) - p);
+    if (values < column->factor) {
+      if (column->isFloat)
+        parseDouble(item, &column->doubles[offset + values]);
+      else
+        parseInt(item, &column->ints[offset + values]);
+    }
+    if (0 == comma)
+      break;
+    p = comma + 1;
+  }
+  values++;
+
+  if (values > column->factor)
+    overflow(column, snp, values);
+}
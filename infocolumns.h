@@ -0,0 +1,67 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef INFOCOLUMNS_H
+#define INFOCOLUMNS_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+#include "textview.h"
+
+
+#define INFO_NO_OVERFLOW ((size_t) -1)
+
+
+//! Declared Integer and Float INFO keys, decoded into typed per-snp columns while loading
+// Each key keeps factor values per snp in one contiguous array, with a bit
+// per snp telling whether the key was there. Values are decoded the way the
+// converter always read the INFO text: a single valued key as a number
+// prefix of its whole text (as atoi or atof did), otherwise the comma
+// separated values one by one, with absent values left at 0. Keys that are
+// not declared as numeric are not kept.
+class InfoColumns {
+ public:
+  struct Column {
+    std::string key;
+    bool isFloat;
+    size_t factor;  //values per snp
+    std::vector<int> ints;        //snps x factor, for Integer keys
+    std::vector<double> doubles;  //snps x factor, for Float keys
+    std::vector<unsigned char> present;  //bit per snp
+
+    size_t overflowSNP;  //first snp with more than factor values, INFO_NO_OVERFLOW if none
+    size_t overflowValues;
+
+    bool isPresent(size_t snp) const { return 0 != (present[snp >> 3] & (1 << (snp & 7))); }
+  };
+
+  InfoColumns();
+  ~InfoColumns();
+
+  //from an ##INFO declaration, before any snps are stored; false if the key is not numeric
+  bool declare(const std::string &key, const std::string &vtype, const std::string &number);
+  void resize(size_t snps);
+
+  //decodes the value of key at snp, only the first value of a key in a row is
+  //kept; snps may be stored concurrently as long as each is stored by one thread
+  void store(const TextView &key, const TextView &value, size_t snp);
+
+  const Column *find(const char *key) const;
+  size_t size() const { return m_columns.size(); }
+
+ private:
+  std::vector<Column> m_columns;  //sorted by key
+  pthread_mutex_t m_overflowLock;
+
+  Column *lookup(const TextView &key);
+  void overflow(Column *column, size_t snp, size_t values);
+
+  InfoColumns(const InfoColumns &);
+  InfoColumns &operator=(const InfoColumns &);
+};
+
+
+#endif
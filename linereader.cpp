@@ -0,0 +1,239 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "linereader.h"
+#include "readaheadsource.h"
+
+
+#define INITIAL_CAPACITY (1 << 20)
+
+
+LineReader::LineReader()
+{
+  m_source = 0;
+  m_buffer = 0;
+  m_capacity = 0;
+  m_begin = 0;
+  m_end = 0;
+  m_lineCount = 0;
+  m_eof = false;
+  m_failed = false;
+  m_mapOffset = 0;
+  m_mapped = false;
+}
+
+
+LineReader::~LineReader()
+{
+  close();
+}
+
+
+bool LineReader::open(const char *file, bool mapped, size_t threads)
+{
+  close();
+
+  m_lineCount = 0;
+  m_eof = false;
+  m_failed = false;
+
+  if (mapped && ByteSource::isCompressed(file)) {
+    printf("compressed input is not mapped, inflating it instead\n");
+    mapped = false;
+  }
+
+  if (mapped) {
+    m_mapped = true;
+    m_mapOffset = 0;
+    return m_map.open(file);
+  }
+
+  m_source = ByteSource::create(file, threads);
+  if (0 == m_source) {
+    return false;
+  }
+  if (threads > 1) {  //the parser has threads of its own, reading keeps going meanwhile
+    ReadAheadSource *source = new ReadAheadSource(m_source);
+    m_source = source;
+    if (!source->start())
+      return false;
+  }
+
+  m_capacity = INITIAL_CAPACITY;
+  m_buffer = new char[m_capacity+1];  //add one for null terminator
+  m_begin = 0;
+  m_end = 0;
+  return true;
+}
+
+
+void LineReader::close()
+{
+  delete m_source;
+  m_source = 0;
+
+  delete[] m_buffer;
+  m_buffer = 0;
+  m_capacity = 0;
+
+  m_map.close();
+  m_mapped = false;
+}
+
+
+// move unread bytes to the front of the buffer, doubling it if a single
+// line fills the whole thing, then read as much as fits
+bool LineReader::fill()
+{
+  size_t remaining = m_end - m_begin;
+
+  if (0 == m_begin && remaining == m_capacity) {
+    size_t capacity = 2 * m_capacity;
+    char *buffer = new char[capacity+1];
+    memcpy(buffer, m_buffer, remaining);
+    delete[] m_buffer;
+    m_buffer = buffer;
+    m_capacity = capacity;
+  }
+  else if (m_begin > 0) {
+    memmove(m_buffer, m_buffer + m_begin, remaining);
+  }
+  m_begin = 0;
+  m_end = remaining;
+
+  size_t n = m_source->read(m_buffer + m_end, m_capacity - m_end);
+  m_end += n;
+
+  if (n == 0) {
+    if (m_source->failed()) {
+      fprintf(stderr, "ERROR failed reading input after line %zu\n", m_lineCount);
+      m_failed = true;
+    }
+    m_eof = true;
+    return false;
+  }
+  return true;
+}
+
+
+bool LineReader::nextMappedLine(const char **line, size_t *length)
+{
+  const char *data = m_map.data();
+  size_t size = m_map.size();
+  if (m_mapOffset >= size)
+    return false;
+
+  const char *begin = data + m_mapOffset;
+  const char *newline = (const char *) memchr(begin, '\n', size - m_mapOffset);
+  *line = begin;
+  if (0 != newline) {
+    *length = newline - begin;
+    m_mapOffset += *length + 1;
+  }
+  else {  //last line without a newline
+    *length = size - m_mapOffset;
+    m_mapOffset = size;
+  }
+  m_lineCount++;
+  return true;
+}
+
+
+bool LineReader::nextLine(const char **line, size_t *length)
+{
+  if (m_mapped)
+    return nextMappedLine(line, length);
+
+  if (0 == m_source || m_failed)
+    return false;
+
+  size_t scanned = m_begin;
+  while (true) {
+    char *newline = (char *) memchr(m_buffer + scanned, '\n', m_end - scanned);
+    if (0 != newline) {
+      *newline = 0;
+      *line = m_buffer + m_begin;
+      *length = newline - *line;
+      m_begin = (newline - m_buffer) + 1;
+      m_lineCount++;
+      return true;
+    }
+
+    if (m_eof) {
+      if (m_begin == m_end)
+        return false;
+      //last line without a newline
+      m_buffer[m_end] = 0;
+      *line = m_buffer + m_begin;
+      *length = m_end - m_begin;
+      m_begin = m_end;
+      m_lineCount++;
+      return true;
+    }
+
+    size_t offset = m_end - m_begin;  //already searched, after fill() the data starts at 0
+    if (!fill() && m_failed)
+      return false;
+    scanned = offset;
+  }
+}
+
+
+bool LineReader::nextBlock(const char **block, size_t *length, size_t minimum)
+{
+  if (m_mapped) {
+    const char *data = m_map.data();
+    size_t size = m_map.size();
+    if (m_mapOffset >= size)
+      return false;
+
+    size_t end = m_mapOffset + minimum;
+    if (end < size) {
+      const char *newline = (const char *) memchr(data + end, '\n', size - end);
+      end = (0 != newline) ? (newline - data) + 1 : size;
+    }
+    else {
+      end = size;
+    }
+    *block = data + m_mapOffset;
+    *length = end - m_mapOffset;
+    m_mapOffset = end;
+    return true;
+  }
+
+  if (0 == m_source || m_failed)
+    return false;
+
+  //read until there is enough and it holds a newline, fill() grows the buffer as needed
+  size_t scanned = m_begin;
+  const char *last = 0;
+  while (true) {
+    if (m_end - m_begin >= minimum || m_eof) {
+      for (const char *p = m_buffer + m_end; p > m_buffer + scanned; p--) {
+        if ('\n' == p[-1]) {
+          last = p;
+          break;
+        }
+      }
+      if (0 != last || m_eof)
+        break;
+      scanned = m_end;
+    }
+    size_t offset = m_begin;
+    if (!fill() && m_failed)
+      return false;
+    scanned -= offset;
+  }
+
+  if (0 == last) {  //last line without a newline
+    if (m_begin == m_end)
+      return false;
+    last = m_buffer + m_end;
+  }
+  *block = m_buffer + m_begin;
+  *length = last - *block;
+  m_begin = last - m_buffer;
+  return true;
+}
@@ -0,0 +1,61 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef LINEREADER_H
+#define LINEREADER_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "mappedfile.h"
+#include "bytesource.h"
+
+
+//! Reads a text file once, front to back, one line at a time
+// Lines can be of any length, the internal buffer grows to fit the longest
+// line seen so far.  The returned line has the newline removed and stays
+// valid until the next call to nextLine().  When reading through a memory
+// mapping the line points straight into the mapped file and is not null
+// terminated, otherwise it is.  Gzip and bgzf input is inflated on the fly,
+// bgzf blocks on several threads.  Given several threads, the input is also
+// read ahead on a thread of its own while the caller parses.  nextBlock()
+// hands out many whole lines at once for parsers that split the work
+// themselves.
+class LineReader {
+ public:
+  LineReader();
+  ~LineReader();
+
+  bool open(const char *file, bool mapped=false, size_t threads=1);
+  void close();
+
+  bool nextLine(const char **line, size_t *length);  //false at end of file, or on error
+  //at least minimum bytes of whole lines (less at end of file), newlines
+  //included, valid until the next call; lines are not counted
+  bool nextBlock(const char **block, size_t *length, size_t minimum);
+  bool failed() const { return m_failed; }
+  size_t lineCount() const { return m_lineCount; }
+
+ private:
+  ByteSource *m_source;
+  char *m_buffer;
+  size_t m_capacity;
+  size_t m_begin;  //start of unread data in m_buffer
+  size_t m_end;    //end of valid data in m_buffer
+  size_t m_lineCount;
+  bool m_eof;
+  bool m_failed;
+
+  MappedFile m_map;
+  size_t m_mapOffset;
+  bool m_mapped;
+
+  bool fill();
+  bool nextMappedLine(const char **line, size_t *length);
+
+  LineReader(const LineReader &);
+  LineReader &operator=(const LineReader &);
+};
+
+
+#endif
@@ -0,0 +1,68 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mappedfile.h"
+
+
+MappedFile::MappedFile()
+{
+  m_data = 0;
+  m_size = 0;
+}
+
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+
+bool MappedFile::open(const char *file)
+{
+  close();
+
+  int fd = ::open(file, O_RDONLY);
+  if (-1 == fd) {
+    fprintf(stderr, "ERROR cannot open %s\n", file);
+    return false;
+  }
+
+  struct stat info;
+  if (0 != fstat(fd, &info)) {
+    fprintf(stderr, "ERROR cannot stat %s\n", file);
+    ::close(fd);
+    return false;
+  }
+
+  m_size = info.st_size;
+  if (0 == m_size) {  //mmap refuses empty files, nothing to map anyway
+    ::close(fd);
+    return true;
+  }
+
+  void *data = mmap(0, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (MAP_FAILED == data) {
+    fprintf(stderr, "ERROR cannot map %s\n", file);
+    m_size = 0;
+    return false;
+  }
+  madvise(data, m_size, MADV_SEQUENTIAL);
+
+  m_data = (const char *) data;
+  return true;
+}
+
+
+void MappedFile::close()
+{
+  if (0 != m_data)
+    munmap((void *) m_data, m_size);
+  m_data = 0;
+  m_size = 0;
+}
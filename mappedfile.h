@@ -0,0 +1,31 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+
+//! Read-only memory mapping of a whole file, unmapped on close or destruction
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  bool open(const char *file);
+  void close();
+
+  const char *data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+ private:
+  const char *m_data;
+  size_t m_size;
+
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+};
+
+
+#endif
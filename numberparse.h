@@ -0,0 +1,187 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef NUMBERPARSE_H
+#define NUMBERPARSE_H
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
+
+#include "textview.h"
+
+
+#define PARSE_FAST_DIGITS 19    //significant digits that always fit in 64 bits
+#define PARSE_FAST_MANTISSA (1ULL << 53)  //largest integer every double below holds exactly
+#define PARSE_FAST_EXPONENT 22  //largest power of ten a double holds exactly
+#define PARSE_COPY_WIDTH 64     //longer numbers are copied to the heap for strtod
+
+
+// Numbers read straight out of a TextView, with no null terminator and no
+// copy, giving exactly what atoi and atof give on the same text. Leading
+// white space, a sign and the longest numeric prefix are read, anything
+// after is ignored, and text with no number reads as 0.
+//
+// The VCF missing value, a lone '.', is told apart from a number: it reads
+// as 0, as before, but the parse returns false, as it does for text that
+// holds no number at all.
+
+
+static inline bool isParseSpace(char c)
+{
+  return ' ' == c || ('\t' <= c && c <= '\r');
+}
+
+
+static inline bool isMissingValue(const TextView &text)
+{
+  return 1 == text.length && '.' == text.ptr[0];
+}
+
+
+//atoi is (int) strtol(text, 0, 10), which saturates at the range of long
+static inline bool parseInt(const TextView &text, int *value)
+{
+  *value = 0;
+  if (isMissingValue(text))
+    return false;
+
+  const char *p = text.ptr;
+  const char *end = p + text.length;
+  while (p < end && isParseSpace(*p))
+    p++;
+
+  bool negative = false;
+  if (p < end && ('-' == *p || '+' == *p))
+    negative = '-' == *p++;
+
+  const char *digits = p;
+  uint64_t u = 0;
+  bool overflow = false;
+  for (; p < end && (unsigned) (*p - '0') < 10; p++) {
+    if (u > (UINT64_MAX - 9) / 10)
+      overflow = true;
+    else
+      u = u * 10 + (*p - '0');
+  }
+  if (p == digits)
+    return false;
+
+  long n;
+  if (negative)
+    n = (overflow || u > (uint64_t) LONG_MAX + 1) ? LONG_MIN : (long) (0 - u);
+  else
+    n = (overflow || u > (uint64_t) LONG_MAX) ? LONG_MAX : (long) u;
+  *value = (int) n;
+  return true;
+}
+
+
+// strtod of a copy, for the numbers the fast path cannot round exactly
+static inline double parseDoubleSlow(const TextView &text)
+{
+  if (text.length < PARSE_COPY_WIDTH) {
+    char buffer[PARSE_COPY_WIDTH];
+    return strtod(text.copy(buffer, PARSE_COPY_WIDTH), 0);
+  }
+  return strtod(text.str().c_str(), 0);
+}
+
+
+//decimal numbers of up to 19 significant digits whose mantissa and power of
+//ten are both exact doubles take one multiply or divide, which rounds
+//correctly; anything else (hex, inf, nan, long or extreme values) goes to strtod
+static inline bool parseDouble(const TextView &text, double *value)
+{
+  *value = 0;
+  if (isMissingValue(text))
+    return false;
+
+  const char *p = text.ptr;
+  const char *end = p + text.length;
+  while (p < end && isParseSpace(*p))
+    p++;
+
+  bool negative = false;
+  if (p < end && ('-' == *p || '+' == *p))
+    negative = '-' == *p++;
+
+  uint64_t mantissa = 0;
+  int significant = 0;
+  int exponent = 0;
+  bool digits = false;
+  bool exact = true;
+  for (; p < end && (unsigned) (*p - '0') < 10; p++) {
+    digits = true;
+    if (0 == mantissa && '0' == *p)
+      continue;
+    if (++significant > PARSE_FAST_DIGITS)
+      exact = false;
+    else
+      mantissa = mantissa * 10 + (*p - '0');
+  }
+  if (p < end && '.' == *p) {
+    for (p++; p < end && (unsigned) (*p - '0') < 10; p++) {
+      digits = true;
+      if (0 == mantissa && '0' == *p) {
+        exponent--;
+        continue;
+      }
+      if (++significant > PARSE_FAST_DIGITS)
+        exact = false;
+      else {
+        mantissa = mantissa * 10 + (*p - '0');
+        exponent--;
+      }
+    }
+  }
+  if (!digits) {  //inf, nan or no number
+    if (p < end && ('i' == (*p | 0x20) || 'n' == (*p | 0x20))) {
+      *value = parseDoubleSlow(text);
+      return true;
+    }
+    return false;
+  }
+  if (p < end && 'x' == (*p | 0x20))  //hex floats start with 0x
+    exact = false;
+
+  if (p < end && 'e' == (*p | 0x20)) {
+    const char *e = p + 1;
+    bool negativeExponent = false;
+    if (e < end && ('-' == *e || '+' == *e))
+      negativeExponent = '-' == *e++;
+    if (e < end && (unsigned) (*e - '0') < 10) {  //otherwise the 'e' is not part of the number
+      int n = 0;
+      for (; e < end && (unsigned) (*e - '0') < 10; e++) {
+        if (n < 100000)
+          n = n * 10 + (*e - '0');
+      }
+      exponent += negativeExponent ? -n : n;
+    }
+  }
+
+  if (!exact || mantissa > PARSE_FAST_MANTISSA || exponent < -PARSE_FAST_EXPONENT || exponent > PARSE_FAST_EXPONENT) {
+    if (0 != mantissa || !exact) {
+      *value = parseDoubleSlow(text);
+      return true;
+    }
+  }
+
+  static const double powers[PARSE_FAST_EXPONENT + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+  };
+  double d = (double) mantissa;
+  if (0 != mantissa) {
+    if (exponent < 0)
+      d /= powers[-exponent];
+    else
+      d *= powers[exponent];
+  }
+  *value = negative ? -d : d;
+  return true;
+}
+
+
+#endif
@@ -0,0 +1,113 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef RAWSAMPLES_H
+#define RAWSAMPLES_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "textview.h"
+#include "stringarena.h"
+
+
+#define RAW_SHARDS 64  //arenas, rows are spread over them so threads rarely wait on one
+
+
+//! Sample columns of the rows whose strings are stored without a lookup
+// A row is copied as one piece with its tabs turned into terminators, and
+// its cells hold the offset of their string in the copy instead of an
+// interner id. Raw cells therefore take no ids at all and their number is
+// only bounded by memory, while a cell stays 32 bits; the sample columns
+// of one row must be shorter than 4GB. Rows are spread over RAW_SHARDS
+// arenas by row number, each with its own lock, which is only taken when
+// rows are stored from several threads at once.
+class RawSamples {
+ public:
+  RawSamples() {
+    for (size_t s = 0; s < RAW_SHARDS; s++) {
+      m_shards[s].longest = 0;
+      pthread_mutex_init(&m_shards[s].mutex, 0);
+    }
+  }
+
+  ~RawSamples() {
+    for (size_t s = 0; s < RAW_SHARDS; s++)
+      pthread_mutex_destroy(&m_shards[s].mutex);
+  }
+
+  //rows not stored raw are marked so, only while no row is being stored
+  void resize(size_t rows) { m_rows.resize(rows, 0); }
+
+  //copy of text[0, length), the tab separated sample columns of row, false if it could not be stored
+  bool store(size_t row, const char *text, size_t length, bool concurrent) {
+    if (length >= UINT32_MAX) {
+      fprintf(stderr, "ERROR sample columns of %zu bytes at SNP %zu, at most 4GB can be stored raw\n", length, row);
+      return false;
+    }
+
+    Shard &shard = m_shards[row % RAW_SHARDS];
+    if (concurrent)
+      pthread_mutex_lock(&shard.mutex);
+    char *copy = shard.arena.allocate(length + 1);
+    if (length > shard.longest)
+      shard.longest = length;
+    if (concurrent)
+      pthread_mutex_unlock(&shard.mutex);
+    if (0 == copy) {
+      fprintf(stderr, "ERROR could not allocate %zu bytes for the sample columns of SNP %zu\n", length, row);
+      return false;
+    }
+
+    memcpy(copy, text, length);
+    copy[length] = 0;
+    for (char *tab = copy; 0 != (tab = (char *) memchr(tab, '\t', copy + length - tab)); )
+      *tab++ = 0;
+    m_rows[row] = copy;
+    return true;
+  }
+
+  bool raw(size_t row) const { return 0 != m_rows[row]; }
+
+  //null terminated string of the cell at offset in a raw row
+  TextView lookup(size_t row, uint32_t offset) const {
+    const char *s = m_rows[row] + offset;
+    return TextView(s, strlen(s));
+  }
+
+  //one past the largest offset a cell can hold
+  uint64_t offsetLimit() const {
+    size_t limit = 0;
+    for (size_t s = 0; s < RAW_SHARDS; s++) {
+      if (m_shards[s].longest > limit)
+        limit = m_shards[s].longest;
+    }
+    return limit;
+  }
+
+  size_t bytesUsed() const {
+    size_t n = 0;
+    for (size_t s = 0; s < RAW_SHARDS; s++)
+      n += m_shards[s].arena.bytesUsed();
+    return n;
+  }
+
+ private:
+  struct Shard {
+    StringArena arena;
+    size_t longest;  //row stored in it
+    pthread_mutex_t mutex;
+  };
+
+  std::vector<const char*> m_rows;  //copy of each raw row, 0 for rows that were looked up
+  Shard m_shards[RAW_SHARDS];
+
+  RawSamples(const RawSamples &);
+  RawSamples &operator=(const RawSamples &);
+};
+
+
+#endif
@@ -0,0 +1,115 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <string.h>
+
+#include "readaheadsource.h"
+
+
+struct ReadAheadChunk {
+  char data[READ_AHEAD_CHUNK_SIZE];
+  size_t size;
+  bool failed;
+};
+
+
+
+ReadAheadSource::ReadAheadSource(ByteSource *source)
+  : m_source(source), m_free(READ_AHEAD_CHUNKS), m_filled(READ_AHEAD_CHUNKS)
+{
+  m_current = 0;
+  m_offset = 0;
+  m_started = false;
+  m_end = false;
+  m_failed = false;
+
+  for (size_t i = 0; i < READ_AHEAD_CHUNKS; i++) {
+    m_chunks.push_back(new ReadAheadChunk);
+    m_free.push(m_chunks.back());
+  }
+}
+
+
+ReadAheadSource::~ReadAheadSource()
+{
+  if (m_started) {  //the caller can stop before the end of input
+    m_free.close();
+    m_filled.close();
+    pthread_join(m_reader, 0);
+  }
+  for (size_t i = 0; i < m_chunks.size(); i++)
+    delete m_chunks[i];
+  delete m_source;
+}
+
+
+bool ReadAheadSource::start()
+{
+  if (0 != pthread_create(&m_reader, 0, readerMain, this)) {
+    fprintf(stderr, "ERROR could not start the thread reading input\n");
+    return false;
+  }
+  m_started = true;
+  return true;
+}
+
+
+void *ReadAheadSource::readerMain(void *arg)
+{
+  ((ReadAheadSource *) arg)->readChunks();
+  return 0;
+}
+
+
+// fills free chunks until the source ends, the last one queued is empty
+void ReadAheadSource::readChunks()
+{
+  ReadAheadChunk *chunk;
+  while (m_free.pop(&chunk)) {
+    chunk->size = 0;
+    while (chunk->size < READ_AHEAD_CHUNK_SIZE) {
+      size_t n = m_source->read(chunk->data + chunk->size, READ_AHEAD_CHUNK_SIZE - chunk->size);
+      if (0 == n)
+        break;
+      chunk->size += n;
+    }
+    chunk->failed = m_source->failed();
+    if (!m_filled.push(chunk) || 0 == chunk->size)
+      break;
+  }
+  m_filled.close();
+}
+
+
+size_t ReadAheadSource::read(char *buffer, size_t n)
+{
+  size_t count = 0;
+  while (count < n && !m_end) {
+    if (0 == m_current) {
+      if (!m_filled.pop(&m_current)) {
+        m_end = true;
+        break;
+      }
+      m_offset = 0;
+      if (m_current->failed)
+        m_failed = true;
+      if (0 == m_current->size) {
+        m_end = true;
+        break;
+      }
+    }
+
+    size_t take = m_current->size - m_offset;
+    if (take > n - count)
+      take = n - count;
+    memcpy(buffer + count, m_current->data + m_offset, take);
+    count += take;
+    m_offset += take;
+
+    if (m_offset == m_current->size) {
+      m_free.push(m_current);
+      m_current = 0;
+    }
+  }
+  return count;
+}
@@ -0,0 +1,56 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef READAHEADSOURCE_H
+#define READAHEADSOURCE_H
+
+#include <pthread.h>
+#include <vector>
+
+#include "bytesource.h"
+#include "boundedqueue.h"
+
+
+#define READ_AHEAD_CHUNK_SIZE (4 << 20)
+#define READ_AHEAD_CHUNKS 4
+
+
+struct ReadAheadChunk;
+
+
+//! Another source read on a thread of its own, a few chunks ahead of the caller
+// Disk reads and inflating then overlap with parsing what was read before.
+// The chunks rotate between a free and a filled BoundedQueue, so the reader
+// waits once READ_AHEAD_CHUNKS are filled and memory stays bounded however
+// far behind the parser falls.
+class ReadAheadSource : public ByteSource {
+ public:
+  ReadAheadSource(ByteSource *source);  //takes ownership of source
+  ~ReadAheadSource();
+
+  bool start();
+  size_t read(char *buffer, size_t n);
+  bool failed() const { return m_failed; }
+
+ private:
+  ByteSource *m_source;
+  std::vector<ReadAheadChunk*> m_chunks;
+  BoundedQueue<ReadAheadChunk*> m_free;
+  BoundedQueue<ReadAheadChunk*> m_filled;
+  ReadAheadChunk *m_current;  //being handed out by read()
+  size_t m_offset;
+
+  pthread_t m_reader;
+  bool m_started;
+  bool m_end;
+  bool m_failed;
+
+  static void *readerMain(void *arg);
+  void readChunks();
+
+  ReadAheadSource(const ReadAheadSource &);
+  ReadAheadSource &operator=(const ReadAheadSource &);
+};
+
+
+#endif
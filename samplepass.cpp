@@ -0,0 +1,267 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <string.h>
+
+#include "samplepass.h"
+
+#include "vcf40.h"
+#include "delimiterscan.h"
+#include "decodecache.h"
+#include "blockbuffers.h"
+#include "transpose.h"
+
+
+
+//! Cells of snps [first, first + count) for every decoder, with what decoding them found
+struct SampleBlock {
+  size_t first;
+  size_t count;
+  std::vector<unsigned char*> cells;  //per decoder, samples x count x width
+  std::vector<char> failed;  //per decoder
+  std::vector<size_t> shortFields;  //per decoder
+};
+
+
+
+//! Samples [first, last) of every decoder in a pass, for the snps of the current block
+// A cache slot holds the cell of each decoder followed by its short flag.
+// The cache lasts for all the blocks, as cells do not depend on the snp.
+// Rows stored raw are decoded cell by cell, their strings rarely repeat.
+// The cells are visited in tiles, as the sample strings are stored by snp
+// and the cells of most variables by sample.
+struct SamplePassRange : public WorkerTask {
+  VCF40 *vcf;
+  const std::vector<SampleDecoder*> *decoders;
+  const std::vector<size_t> *slotOffsets;
+  size_t slotWidth;
+  size_t cacheBytes;
+  DecodeCache<unsigned char> *cache;
+  SampleBlock *block;
+  std::vector<char> failed;  //per decoder, in this block
+  std::vector<size_t> shortFields;
+  size_t first;
+  size_t last;
+  bool ok;
+
+  void run();
+};
+
+
+void SamplePassRange::run()
+{
+  const std::vector<SampleDecoder*> &d = *decoders;
+  const std::vector<size_t> &offset = *slotOffsets;
+  size_t n = d.size();
+  size_t count = block->count;
+  size_t nSamples = vcf->nSamples;
+  std::vector<TextView> fields;
+  std::vector<TextView> scratch;
+  std::vector<unsigned char> fresh(slotWidth);
+  if (0 == cache)
+    cache = new DecodeCache<unsigned char>(slotWidth, vcf->uniqueStrings.idLimit(), cacheBytes);
+
+  failed.assign(n, 0);
+  shortFields.assign(n, 0);
+  ok = true;
+  size_t end = block->first + count;
+  for (size_t i0 = block->first; i0 < end; i0 += TRANSPOSE_TILE) {
+    size_t i1 = (i0 + TRANSPOSE_TILE < end) ? i0 + TRANSPOSE_TILE : end;
+    for (size_t k0 = first; k0 < last; k0 += TRANSPOSE_TILE) {
+      size_t k1 = (k0 + TRANSPOSE_TILE < last) ? k0 + TRANSPOSE_TILE : last;
+      for (size_t i = i0; i < i1; i++) {
+        uint32_t schema = vcf->format[i];
+        bool raw = vcf->rawSamples.raw(i);  //cells are offsets into the row, not ids
+
+        for (size_t k = k0; k < k1; k++) {
+          uint32_t id = vcf->perSampleString(i, k);
+          size_t bySample = k * count + (i - block->first);
+          size_t bySNP = (i - block->first) * nSamples + k;
+          const unsigned char *slot = raw ? 0 : cache->find(id, schema);
+          if (0 != slot) {
+            for (size_t j = 0; j < n; j++) {
+              if (failed[j])
+                continue;
+              size_t index = d[j]->snpMajor ? bySNP : bySample;
+              memcpy(block->cells[j] + index * d[j]->width, slot + offset[j], d[j]->width);
+              shortFields[j] += slot[ offset[j] + d[j]->width ];
+            }
+            continue;
+          }
+
+          splitView(vcf->sampleString(i, k), ':', &fields);
+          bool complete = true;
+          for (size_t j = 0; j < n; j++) {
+            if (failed[j])
+              continue;
+            unsigned char *cell = block->cells[j] + (d[j]->snpMajor ? bySNP : bySample) * d[j]->width;
+            bool isShort = false;
+            if (!d[j]->decode(fields, d[j]->offsets[schema], i, cell, &scratch, &isShort)) {
+              failed[j] = 1;
+              complete = false;
+              continue;
+            }
+            memcpy(&fresh[ offset[j] ], cell, d[j]->width);
+            fresh[ offset[j] + d[j]->width ] = isShort;
+            shortFields[j] += isShort;
+          }
+          if (complete && !raw)
+            memcpy(cache->insert(id, schema), &fresh[0], slotWidth);
+        }     //end sample loop
+      }
+    }
+  } // end tile loop
+
+  for (size_t j = 0; j < n; j++) {
+    size_t width = d[j]->width;
+    if (!d[j]->snpMajor) {
+      d[j]->finish(block->cells[j] + first * count * width, (last - first) * count * width);
+      continue;
+    }
+    for (size_t i = 0; i < count; i++)
+      d[j]->finish(block->cells[j] + (i * nSamples + first) * width, (last - first) * width);
+  }
+}
+
+
+
+SamplePass::SamplePass(VCF40 *vcf)
+  : m_vcf(vcf), m_pool(0), m_slotWidth(0), m_cacheBytes(0), m_blockSNPs(0),
+    m_free(SAMPLE_PASS_BLOCKS), m_decoded(SAMPLE_PASS_BLOCKS), m_started(false)
+{
+}
+
+
+SamplePass::~SamplePass()
+{
+  if (m_started) {  //write() was not called
+    m_free.close();
+    m_decoded.close();
+    pthread_join(m_producer, 0);
+  }
+  for (size_t b = 0; b < m_blocks.size(); b++) {
+    for (size_t j = 0; j < m_blocks[b]->cells.size(); j++)
+      delete[] m_blocks[b]->cells[j];
+    delete m_blocks[b];
+  }
+}
+
+
+
+bool SamplePass::start(ThreadPool *pool, size_t maxBytes)
+{
+  size_t nSamples = m_vcf->nSamples;
+  size_t cellWidth = 0;
+  m_slotOffsets.clear();
+  m_slotWidth = 0;
+  for (size_t j = 0; j < m_decoders.size(); j++) {
+    m_slotOffsets.push_back(m_slotWidth);
+    m_slotWidth += m_decoders[j]->width + 1;
+    cellWidth += m_decoders[j]->width;
+  }
+
+  //the caches first, so they can not push the blocks past maxBytes
+  m_pool = pool;
+  size_t nRanges = sampleRanges(pool, nSamples);
+  m_cacheBytes = maxBytes / SAMPLE_PASS_CACHE_SHARE / ((0 == nRanges) ? 1 : nRanges);
+  if (m_cacheBytes > DECODE_CACHE_BYTES)
+    m_cacheBytes = DECODE_CACHE_BYTES;
+  size_t blockBytes = maxBytes - nRanges * m_cacheBytes;
+  m_blockSNPs = blockSNPs(blockBytes / SAMPLE_PASS_BLOCKS, nSamples * cellWidth, m_vcf->nSNPs);
+  for (size_t b = 0; b < SAMPLE_PASS_BLOCKS; b++) {
+    SampleBlock *block = new SampleBlock;
+    for (size_t j = 0; j < m_decoders.size(); j++)
+      block->cells.push_back(new unsigned char[nSamples * m_blockSNPs * m_decoders[j]->width]);
+    m_blocks.push_back(block);
+    m_free.push(block);
+  }
+
+  if (0 != pthread_create(&m_producer, 0, producerMain, this)) {
+    fprintf(stderr, "ERROR could not start the thread decoding sample strings\n");
+    return false;
+  }
+  m_started = true;
+  return true;
+}
+
+
+void *SamplePass::producerMain(void *arg)
+{
+  ((SamplePass *) arg)->produce();
+  return 0;
+}
+
+
+// decodes the blocks in order into free ones and queues them for write()
+void SamplePass::produce()
+{
+  SamplePassRange range;
+  range.vcf = m_vcf;
+  range.decoders = &m_decoders;
+  range.slotOffsets = &m_slotOffsets;
+  range.slotWidth = m_slotWidth;
+  range.cacheBytes = m_cacheBytes;
+  range.cache = 0;
+
+  std::vector<SamplePassRange> ranges;
+  partitionSamples(m_pool, range, m_vcf->nSamples, &ranges);
+
+  size_t nSNPs = m_vcf->nSNPs;
+  for (size_t first = 0; first < nSNPs; first += m_blockSNPs) {
+    SampleBlock *block;
+    if (!m_free.pop(&block))  //write() stopped
+      break;
+    block->first = first;
+    block->count = (first + m_blockSNPs < nSNPs) ? m_blockSNPs : nSNPs - first;
+    for (size_t i = 0; i < ranges.size(); i++)
+      ranges[i].block = block;
+    runSampleRanges(m_pool, &ranges);
+
+    block->failed.assign(m_decoders.size(), 0);
+    block->shortFields.assign(m_decoders.size(), 0);
+    bool failed = false;
+    for (size_t i = 0; i < ranges.size(); i++) {
+      for (size_t j = 0; j < m_decoders.size(); j++) {
+        if (ranges[i].failed[j])
+          block->failed[j] = failed = true;
+        block->shortFields[j] += ranges[i].shortFields[j];
+      }
+    }
+    if (!m_decoded.push(block) || failed)
+      break;
+  }
+  m_decoded.close();
+
+  for (size_t i = 0; i < ranges.size(); i++)
+    delete ranges[i].cache;
+}
+
+
+
+bool SamplePass::write()
+{
+  if (!m_started)
+    return false;
+
+  bool ok = true;
+  SampleBlock *block;
+  while (m_decoded.pop(&block)) {
+    for (size_t j = 0; j < m_decoders.size() && ok; j++) {
+      SampleDecoder *d = m_decoders[j];
+      d->shortFields += block->shortFields[j];
+      if (block->failed[j] || !d->store(block->cells[j], block->first, block->count, m_vcf->nSamples))
+        d->ok = false;
+      ok = d->ok;
+    }
+    if (ok)
+      m_free.push(block);
+    else {
+      m_free.close();  //the producer stops at its next block
+      m_decoded.close();
+    }
+  }
+
+  pthread_join(m_producer, 0);
+  m_started = false;
+  return ok;
+}
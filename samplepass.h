@@ -0,0 +1,170 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef SAMPLEPASS_H
+#define SAMPLEPASS_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "textview.h"
+#include "threadpool.h"
+#include "boundedqueue.h"
+
+
+#define SAMPLE_RANGES_PER_THREAD 4
+
+
+class VCF40;
+
+
+// as many sample ranges as the pool runs well
+static inline size_t sampleRanges(ThreadPool *pool, size_t nSamples)
+{
+  size_t n = (0 == pool) ? 1 : pool->threads() * SAMPLE_RANGES_PER_THREAD;
+  return (n > nSamples) ? nSamples : n;
+}
+
+
+// copies of range over consecutive sample ranges
+template <typename R>
+static void partitionSamples(ThreadPool *pool, const R &range, size_t nSamples, std::vector<R> *ranges)
+{
+  size_t n = sampleRanges(pool, nSamples);
+  ranges->assign(n, range);
+
+  for (size_t i = 0; i < n; i++) {
+    R &r = (*ranges)[i];
+    r.first = i * nSamples / n;
+    r.last = (i + 1) * nSamples / n;
+  }
+}
+
+
+// runs the ranges, on the pool if there is one
+template <typename R>
+static bool runSampleRanges(ThreadPool *pool, std::vector<R> *ranges)
+{
+  for (size_t i = 0; i < ranges->size(); i++) {
+    if (0 != pool)
+      pool->submit(&(*ranges)[i]);
+    else
+      (*ranges)[i].run();
+  }
+  if (0 != pool)
+    pool->waitAll();
+
+  for (size_t i = 0; i < ranges->size(); i++) {
+    if (!(*ranges)[i].ok)
+      return false;
+  }
+  return true;
+}
+
+
+template <typename R>
+static bool decodeSampleRanges(ThreadPool *pool, const R &range, size_t nSamples, std::vector<R> *ranges)
+{
+  partitionSamples(pool, range, nSamples, ranges);
+  return runSampleRanges(pool, ranges);
+}
+
+
+
+//! One per-sample variable, decoded from the sample strings by a SamplePass
+// The pass decodes a block of snps at a time into cells of samples x snps,
+// or snps x samples if snpMajor, width bytes each, in the order the
+// variable is written, and store()
+// writes them to the variable. decode() and finish() are called from every
+// sample range at once, so they keep no state of their own; decode()
+// returns false after an error message when the values do not fit, and the
+// pass stops. store() is only called from the thread writing the blocks.
+class SampleDecoder {
+ public:
+  SampleDecoder(size_t width) : width(width), snpMajor(false), ok(true), shortFields(0) { }
+  virtual ~SampleDecoder() { }
+
+  //cell of snp from the ':' separated fields of its sample string, subfield
+  //is the index of the variable's field among them, -1 if it is missing
+  virtual bool decode(const std::vector<TextView> &fields, int subfield, size_t snp, unsigned char *cell,
+                      std::vector<TextView> *scratch, bool *isShort)=0;
+
+  //n bytes of consecutive cells, all decoded
+  virtual void finish(unsigned char *cells, size_t n) { }
+
+  //the cells of snps [firstSNP, firstSNP + nSNPs) of every sample into the variable
+  virtual bool store(const unsigned char *cells, size_t firstSNP, size_t nSNPs, size_t nSamples)=0;
+
+  size_t width;
+  bool snpMajor;
+  std::vector<int> offsets;  //index of the field in each FORMAT schema, -1 if missing
+  bool ok;
+  size_t shortFields;  //completed with defaults
+
+ private:
+  SampleDecoder(const SampleDecoder &);
+  SampleDecoder &operator=(const SampleDecoder &);
+};
+
+
+
+#define SAMPLE_PASS_BLOCKS 3  //in flight, one decoding, one queued and one writing
+#define SAMPLE_PASS_CACHE_SHARE 4  //the caches of all ranges take at most 1/4 of maxBytes
+
+
+struct SampleBlock;
+
+
+//! Single traversal of the interned sample strings for every per-sample variable
+// Each string is split once per cell and every decoder takes its field from
+// the same split, rather than each variable walking all snps and samples
+// again. The sample ranges cache the cells of all decoders per string id
+// and FORMAT schema, so a repeated string is only copied.
+//
+// The snps are decoded in blocks on a producer thread of the pass, with the
+// sample ranges on the pool, and handed through a bounded queue to write(),
+// which stores them on the calling thread, so netCDF is only ever called
+// from there while the next blocks are being decoded. The blocks in flight
+// and the caches fit in maxBytes together, so memory does not grow with the
+// number of snps or threads.
+class SamplePass {
+ public:
+  SamplePass(VCF40 *vcf);
+  ~SamplePass();
+
+  //the pass does not own the decoder
+  void add(SampleDecoder *decoder) { m_decoders.push_back(decoder); }
+  size_t size() const { return m_decoders.size(); }
+
+  //starts decoding, the calling thread can do other work before write()
+  bool start(ThreadPool *pool, size_t maxBytes);
+
+  //stores the blocks as they are decoded, false once a decoder or a store fails
+  bool write();
+
+  bool run(ThreadPool *pool, size_t maxBytes) { return start(pool, maxBytes) && write(); }
+
+ private:
+  VCF40 *m_vcf;
+  ThreadPool *m_pool;
+  std::vector<SampleDecoder*> m_decoders;
+  std::vector<size_t> m_slotOffsets;  //of each decoder in a cache slot
+  size_t m_slotWidth;
+  size_t m_cacheBytes;  //per sample range
+  size_t m_blockSNPs;
+
+  std::vector<SampleBlock*> m_blocks;
+  BoundedQueue<SampleBlock*> m_free;
+  BoundedQueue<SampleBlock*> m_decoded;
+  pthread_t m_producer;
+  bool m_started;
+
+  static void *producerMain(void *arg);
+  void produce();
+
+  SamplePass(const SamplePass &);
+  SamplePass &operator=(const SamplePass &);
+};
+
+
+#endif
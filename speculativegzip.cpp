@@ -0,0 +1,616 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "speculativegzip.h"
+
+
+#ifndef SPECULATIVE_CHUNK_SIZE
+#define SPECULATIVE_CHUNK_SIZE (4 << 20)  //compressed bytes per chunk
+#endif
+#define SYNC_SEARCH_LIMIT (SPECULATIVE_CHUNK_SIZE / 4)
+#define SYNC_TRIAL_SIZE (1 << 16)
+#define DEFLATE_WINDOW 32768
+#define INFLATE_INPUT_STEP (1 << 30)
+#define PLACEHOLDER 0   //never part of a VCF, stands in for unknown window bytes
+
+
+static const char s_placeholderWindow[DEFLATE_WINDOW] = { PLACEHOLDER };
+
+
+enum ChunkTask { CHUNK_SEARCH, CHUNK_INFLATE, CHUNK_RESOLVE };
+
+
+struct InflateChunk : public WorkerTask {
+  z_stream stream;
+  const unsigned char *input;  //deflate data of the member, up to the end of the file
+  size_t inputSize;
+  ChunkTask task;
+
+  size_t searchBegin;    //bits, range scanned for a block start
+  size_t searchEnd;
+
+  size_t startBit;
+  size_t stopBit;
+  bool exactStop;        //must end exactly on stopBit, else at the first block boundary past it
+  bool speculative;      //started against the placeholder window
+  std::vector<char> dictionary;
+
+  std::vector<char> output;
+  size_t outputSize;
+  size_t endBit;
+  long lastPlaceholder;  //last output byte that may come from the unknown window, -1 if none
+  unsigned long crc;
+  bool streamEnd;
+  bool ok;
+
+  InflateChunk();
+  ~InflateChunk();
+  void run();
+
+  bool begin(size_t bit, const char *window, size_t windowSize);
+  void feed();
+  size_t bitPosition() const;
+  bool inflateRange(size_t limit);
+  bool trial(size_t bit);
+  void search();
+  void resolve();
+};
+
+
+InflateChunk::InflateChunk()
+{
+  memset(&stream, 0, sizeof(stream));
+  if (Z_OK != inflateInit2(&stream, -15)) {  //raw deflate
+    fprintf(stderr, "ERROR could not initialize zlib\n");
+    exit(-1);
+  }
+  input = 0;
+  inputSize = 0;
+  task = CHUNK_INFLATE;
+  searchBegin = searchEnd = 0;
+  startBit = stopBit = 0;
+  exactStop = false;
+  speculative = false;
+  output.resize(SYNC_TRIAL_SIZE);
+  outputSize = 0;
+  endBit = 0;
+  lastPlaceholder = -1;
+  crc = 0;
+  streamEnd = false;
+  ok = false;
+}
+
+
+InflateChunk::~InflateChunk()
+{
+  inflateEnd(&stream);
+}
+
+
+void InflateChunk::run()
+{
+  switch (task) {
+  case CHUNK_SEARCH:
+    search();
+    break;
+  case CHUNK_INFLATE:
+    ok = inflateRange(0);
+    lastPlaceholder = -1;
+    if (ok && speculative) {
+      for (size_t i = outputSize; i > 0; i--) {
+        if (PLACEHOLDER == output[i-1]) {
+          lastPlaceholder = i - 1;
+          break;
+        }
+      }
+    }
+    break;
+  case CHUNK_RESOLVE:
+    resolve();
+    break;
+  }
+}
+
+
+// restart the stream at a bit offset, priming the bits of a partial first byte
+bool InflateChunk::begin(size_t bit, const char *window, size_t windowSize)
+{
+  size_t byte = (bit + 7) / 8;
+  if (byte > inputSize)
+    return false;
+
+  inflateReset(&stream);
+  if (windowSize > 0)
+    inflateSetDictionary(&stream, (const Bytef *) window, windowSize);
+  int bits = byte * 8 - bit;
+  if (bits > 0)
+    inflatePrime(&stream, bits, input[byte-1] >> (8 - bits));
+
+  stream.next_in = (Bytef *) input + byte;
+  stream.avail_in = 0;
+  feed();
+  return true;
+}
+
+
+void InflateChunk::feed()
+{
+  if (0 == stream.avail_in) {
+    size_t rest = inputSize - (stream.next_in - input);
+    stream.avail_in = (rest > INFLATE_INPUT_STEP) ? INFLATE_INPUT_STEP : rest;
+  }
+}
+
+
+size_t InflateChunk::bitPosition() const
+{
+  return (stream.next_in - input) * 8 - (stream.data_type & 7);
+}
+
+
+// inflate from the position set by begin() into output until stopBit, or
+// until limit bytes if limit is not 0
+bool InflateChunk::inflateRange(size_t limit)
+{
+  outputSize = 0;
+  streamEnd = false;
+
+  while (true) {
+    if (outputSize == output.size())
+      output.resize(2 * output.size());
+    size_t room = output.size() - outputSize;
+    if (limit > 0 && room > limit - outputSize)
+      room = limit - outputSize;
+    stream.next_out = (Bytef *) &output[outputSize];
+    stream.avail_out = (room > UINT_MAX) ? UINT_MAX : room;
+
+    feed();
+    int ret = inflate(&stream, Z_BLOCK);
+    outputSize = (char *) stream.next_out - &output[0];
+
+    if (Z_STREAM_END == ret) {
+      streamEnd = true;
+      endBit = bitPosition();
+      return limit > 0 || !exactStop;  //a block start was promised after this one
+    }
+    if (Z_OK != ret && Z_BUF_ERROR != ret)
+      return false;
+    if (limit > 0 && outputSize == limit)
+      return true;
+    if (0 == stream.avail_in && (size_t) ((const unsigned char *) stream.next_in - input) == inputSize
+        && 0 != stream.avail_out)
+      return false;  //truncated
+
+    if ((stream.data_type & 128) && !(stream.data_type & 64)) {  //at a block boundary, not past the last block
+      size_t bit = bitPosition();
+      if (exactStop && bit > stopBit)
+        return false;
+      if (bit >= stopBit) {
+        endBit = bit;
+        return true;
+      }
+    }
+  }
+}
+
+
+// cheap test of the fixed part of a non-final dynamic block header
+static bool plausibleBlockHeader(const unsigned char *input, size_t inputSize, size_t bit)
+{
+  size_t byte = bit / 8;
+  if (byte + 3 > inputSize)
+    return false;
+  unsigned int v = (input[byte] | (input[byte+1] << 8) | (input[byte+2] << 16)) >> (bit & 7);
+  return 0 == (v & 1)             //BFINAL
+    && 2 == ((v >> 1) & 3)        //dynamic huffman
+    && ((v >> 3) & 31) <= 29      //HLIT
+    && ((v >> 8) & 31) <= 29;     //HDIST
+}
+
+
+static bool looksLikeText(const char *p, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    unsigned char c = p[i];
+    if (c < 0x20 && '\t' != c && '\n' != c && '\r' != c && PLACEHOLDER != c)
+      return false;
+  }
+  return true;
+}
+
+
+// does a block start at bit: the huffman tables must be valid, and the first
+// block must inflate to text against the placeholder window
+bool InflateChunk::trial(size_t bit)
+{
+  if (!begin(bit, 0, 0))
+    return false;
+  stream.next_out = (Bytef *) &output[0];
+  stream.avail_out = SYNC_TRIAL_SIZE;
+  if (Z_OK != inflate(&stream, Z_TREES) || !(stream.data_type & 256))
+    return false;
+
+  begin(bit, s_placeholderWindow, DEFLATE_WINDOW);
+  stream.next_out = (Bytef *) &output[0];
+  stream.avail_out = SYNC_TRIAL_SIZE;
+  while (stream.avail_out > 0) {
+    int ret = inflate(&stream, Z_BLOCK);
+    if (Z_STREAM_END == ret || (stream.data_type & 128))
+      break;
+    if (Z_OK != ret)
+      return false;
+  }
+  size_t n = SYNC_TRIAL_SIZE - stream.avail_out;
+  return n > 0 && looksLikeText(&output[0], n);
+}
+
+
+void InflateChunk::search()
+{
+  ok = false;
+  for (size_t bit = searchBegin; bit < searchEnd; bit++) {
+    if (plausibleBlockHeader(input, inputSize, bit) && trial(bit)) {
+      startBit = bit;
+      ok = true;
+      return;
+    }
+  }
+}
+
+
+// re-inflate the bytes that depended on the placeholder window now that the
+// real window is in dictionary, then checksum the chunk
+void InflateChunk::resolve()
+{
+  if (lastPlaceholder >= 0) {
+    size_t size = outputSize;
+    size_t end = endBit;
+    bool atEnd = streamEnd;
+    size_t limit = lastPlaceholder + 1;
+
+    ok = begin(startBit, &dictionary[0], dictionary.size())
+      && inflateRange(limit) && outputSize == limit;
+
+    outputSize = size;
+    endBit = end;
+    streamEnd = atEnd;
+    if (!ok)
+      return;
+    lastPlaceholder = -1;
+  }
+  crc = crc32(0, (const Bytef *) &output[0], outputSize);
+}
+
+
+
+
+static size_t gzipHeaderSize(const unsigned char *p, size_t n)
+{
+  if (n < 10 || 0x1f != p[0] || 0x8b != p[1] || 8 != p[2])
+    return 0;
+
+  int flags = p[3];
+  size_t pos = 10;
+  if (flags & 4) {  //FEXTRA
+    if (pos + 2 > n)
+      return 0;
+    pos += 2 + (p[pos] | (p[pos+1] << 8));
+  }
+  for (int flag = 8; flag <= 16; flag *= 2) {  //FNAME, FCOMMENT
+    if (flags & flag) {
+      while (pos < n && 0 != p[pos])
+        pos++;
+      pos++;
+    }
+  }
+  if (flags & 2)  //FHCRC
+    pos += 2;
+  return (pos < n) ? pos : 0;
+}
+
+
+static unsigned int littleEndian32(const unsigned char *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+
+
+
+SpeculativeGzipSource::SpeculativeGzipSource(size_t threads) : m_pool(threads)
+{
+  m_roundChunks = 0;
+  m_readChunk = 0;
+  m_readOffset = 0;
+  m_memberStart = 0;
+  m_bit = 0;
+  m_crc = 0;
+  m_memberSize = 0;
+  m_fallbacks = 0;
+  m_memberEnd = false;
+  m_inputEnd = false;
+  m_failed = false;
+
+  m_chunks.resize(m_pool.threads());
+  for (size_t i = 0; i < m_chunks.size(); i++)
+    m_chunks[i] = new InflateChunk;
+}
+
+
+SpeculativeGzipSource::~SpeculativeGzipSource()
+{
+  m_pool.waitAll();
+  for (size_t i = 0; i < m_chunks.size(); i++)
+    delete m_chunks[i];
+  if (m_fallbacks > 0)
+    printf("speculative inflate redid %zu rounds on one thread\n", m_fallbacks);
+}
+
+
+bool SpeculativeGzipSource::open(const char *file)
+{
+  return m_map.open(file) && startMember(0);
+}
+
+
+bool SpeculativeGzipSource::startMember(size_t offset)
+{
+  const unsigned char *data = (const unsigned char *) m_map.data();
+  size_t header = gzipHeaderSize(data + offset, m_map.size() - offset);
+  if (0 == header) {
+    fprintf(stderr, "ERROR invalid gzip header at byte %zu\n", offset);
+    m_failed = true;
+    return false;
+  }
+
+  m_memberStart = offset + header;
+  m_bit = 0;
+  m_window.clear();
+  m_crc = crc32(0, 0, 0);
+  m_memberSize = 0;
+  m_memberEnd = false;
+  return true;
+}
+
+
+// check the trailer of the member that ended at endBit and move to the next one
+bool SpeculativeGzipSource::finishMember(size_t endBit)
+{
+  const unsigned char *data = (const unsigned char *) m_map.data();
+  size_t trailer = m_memberStart + (endBit + 7) / 8;
+  if (trailer + 8 > m_map.size()) {
+    fprintf(stderr, "ERROR gzip input is truncated or unreadable\n");
+    m_failed = true;
+    return false;
+  }
+  if (littleEndian32(data + trailer) != m_crc
+      || littleEndian32(data + trailer + 4) != (m_memberSize & 0xffffffff)) {
+    fprintf(stderr, "ERROR gzip checksum mismatch\n");
+    m_failed = true;
+    return false;
+  }
+
+  size_t next = trailer + 8;
+  if (next + 2 <= m_map.size() && 0x1f == data[next] && 0x8b == data[next+1])
+    return startMember(next);
+  m_inputEnd = true;  //anything after the last member is ignored
+  return true;
+}
+
+
+// search the slices after the first for block starts; chunks without one
+// are dropped, so the previous chunk covers their slice as well
+size_t SpeculativeGzipSource::findSyncPoints(size_t startByte, size_t chunks)
+{
+  size_t inputSize = m_map.size() - m_memberStart;
+  for (size_t i = 1; i < chunks; i++) {
+    InflateChunk *chunk = m_chunks[i];
+    size_t begin = startByte + i * SPECULATIVE_CHUNK_SIZE;
+    size_t end = begin + SYNC_SEARCH_LIMIT;
+    chunk->task = CHUNK_SEARCH;
+    chunk->searchBegin = begin * 8;
+    chunk->searchEnd = ((end < inputSize) ? end : inputSize) * 8;
+    m_pool.submit(chunk);
+  }
+  m_pool.waitAll();
+
+  size_t found = 1;
+  for (size_t i = 1; i < chunks; i++) {
+    if (m_chunks[i]->ok) {
+      InflateChunk *chunk = m_chunks[i];
+      m_chunks[i] = m_chunks[found];
+      m_chunks[found++] = chunk;
+    }
+  }
+  return found;
+}
+
+
+// the whole round on the calling thread, starting from the known position
+bool SpeculativeGzipSource::sequentialRound(size_t roundEndBit)
+{
+  InflateChunk *chunk = m_chunks[0];
+  chunk->dictionary = m_window;
+  chunk->speculative = false;
+  chunk->exactStop = false;
+  chunk->stopBit = roundEndBit;
+  chunk->startBit = m_bit;
+
+  chunk->ok = chunk->begin(m_bit, chunk->dictionary.empty() ? 0 : &chunk->dictionary[0], chunk->dictionary.size())
+    && chunk->inflateRange(0);
+  if (!chunk->ok)
+    return false;
+  chunk->lastPlaceholder = -1;
+  chunk->task = CHUNK_RESOLVE;
+  chunk->run();
+  return true;
+}
+
+
+// the last DEFLATE_WINDOW bytes inflated before the given chunk of this round
+void SpeculativeGzipSource::windowBefore(size_t chunk, std::vector<char> *window) const
+{
+  size_t first = chunk;
+  size_t total = 0;
+  while (first > 0 && total < DEFLATE_WINDOW) {
+    first--;
+    total += m_chunks[first]->outputSize;
+  }
+
+  window->clear();
+  if (total < DEFLATE_WINDOW) {  //reaches back into the previous round
+    size_t n = DEFLATE_WINDOW - total;
+    if (n > m_window.size())
+      n = m_window.size();
+    window->insert(window->end(), m_window.end() - n, m_window.end());
+  }
+  size_t skip = (total > DEFLATE_WINDOW) ? total - DEFLATE_WINDOW : 0;
+  for (size_t i = first; i < chunk; i++) {
+    const InflateChunk *c = m_chunks[i];
+    window->insert(window->end(), c->output.begin() + skip, c->output.begin() + c->outputSize);
+    skip = 0;
+  }
+}
+
+
+// chunks whose predecessor ends in at least a window of clean bytes are
+// resolved in parallel, the others in order once their predecessor is done
+void SpeculativeGzipSource::resolveChunks(size_t chunks)
+{
+  std::vector<bool> deferred(chunks, false);
+  for (size_t i = 0; i < chunks; i++) {
+    InflateChunk *chunk = m_chunks[i];
+    chunk->task = CHUNK_RESOLVE;
+    if (chunk->lastPlaceholder >= 0) {
+      const InflateChunk *previous = m_chunks[i-1];
+      if (previous->outputSize < DEFLATE_WINDOW
+          || previous->lastPlaceholder >= (long) (previous->outputSize - DEFLATE_WINDOW)) {
+        deferred[i] = true;
+        continue;
+      }
+      windowBefore(i, &chunk->dictionary);
+    }
+    m_pool.submit(chunk);
+  }
+  m_pool.waitAll();
+
+  for (size_t i = 0; i < chunks; i++) {
+    if (deferred[i]) {
+      windowBefore(i, &m_chunks[i]->dictionary);
+      m_chunks[i]->run();
+    }
+  }
+}
+
+
+bool SpeculativeGzipSource::nextRound()
+{
+  if (m_inputEnd || m_failed)
+    return false;
+
+  size_t inputSize = m_map.size() - m_memberStart;
+  size_t startByte = m_bit / 8;
+  size_t chunks = (inputSize - startByte) / SPECULATIVE_CHUNK_SIZE;
+  if (chunks > m_chunks.size())
+    chunks = m_chunks.size();
+  if (chunks < 1)
+    chunks = 1;
+  size_t roundEndBit = (startByte + chunks * SPECULATIVE_CHUNK_SIZE) * 8;
+
+  for (size_t i = 0; i < m_chunks.size(); i++) {
+    m_chunks[i]->input = (const unsigned char *) m_map.data() + m_memberStart;
+    m_chunks[i]->inputSize = inputSize;
+  }
+
+  if (chunks > 1)
+    chunks = findSyncPoints(startByte, chunks);
+
+  bool ok = false;
+  if (chunks > 1) {
+    for (size_t i = 0; i < chunks; i++) {
+      InflateChunk *chunk = m_chunks[i];
+      chunk->task = CHUNK_INFLATE;
+      chunk->speculative = (i > 0);
+      if (0 == i) {
+        chunk->startBit = m_bit;
+        chunk->dictionary = m_window;
+      }
+      chunk->exactStop = (i + 1 < chunks);
+      chunk->stopBit = chunk->exactStop ? m_chunks[i+1]->startBit : roundEndBit;
+      if (chunk->speculative)
+        chunk->begin(chunk->startBit, s_placeholderWindow, DEFLATE_WINDOW);
+      else
+        chunk->begin(chunk->startBit, chunk->dictionary.empty() ? 0 : &chunk->dictionary[0], chunk->dictionary.size());
+      m_pool.submit(chunk);
+    }
+    m_pool.waitAll();
+
+    ok = true;
+    for (size_t i = 0; i < chunks; i++)
+      ok = ok && m_chunks[i]->ok;
+    if (ok) {
+      resolveChunks(chunks);
+      for (size_t i = 0; i < chunks; i++)
+        ok = ok && m_chunks[i]->ok;
+    }
+    if (!ok) {  //a block start was a false positive
+      m_fallbacks++;
+      chunks = 1;
+    }
+  }
+  if (!ok && !sequentialRound(roundEndBit)) {
+    fprintf(stderr, "ERROR could not inflate gzip input\n");
+    m_failed = true;
+    return false;
+  }
+
+  for (size_t i = 0; i < chunks; i++) {
+    m_crc = crc32_combine(m_crc, m_chunks[i]->crc, m_chunks[i]->outputSize);
+    m_memberSize += m_chunks[i]->outputSize;
+  }
+  std::vector<char> window;
+  windowBefore(chunks, &window);
+  m_window.swap(window);
+
+  m_roundChunks = chunks;
+  m_readChunk = 0;
+  m_readOffset = 0;
+
+  InflateChunk *last = m_chunks[chunks-1];
+  m_bit = last->endBit;
+  if (last->streamEnd)
+    return finishMember(last->endBit);
+  return true;
+}
+
+
+size_t SpeculativeGzipSource::read(char *buffer, size_t n)
+{
+  size_t copied = 0;
+  while (copied < n && !m_failed) {
+    if (m_readChunk >= m_roundChunks) {
+      if (!nextRound())
+        break;
+      continue;
+    }
+
+    InflateChunk *chunk = m_chunks[m_readChunk];
+    size_t count = chunk->outputSize - m_readOffset;
+    if (count > n - copied)
+      count = n - copied;
+    memcpy(buffer + copied, &chunk->output[m_readOffset], count);
+    copied += count;
+    m_readOffset += count;
+
+    if (m_readOffset == chunk->outputSize) {
+      m_readChunk++;
+      m_readOffset = 0;
+    }
+  }
+
+  return m_failed ? 0 : copied;
+}
@@ -0,0 +1,66 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef SPECULATIVEGZIP_H
+#define SPECULATIVEGZIP_H
+
+#include <vector>
+
+#include "bytesource.h"
+#include "mappedfile.h"
+#include "threadpool.h"
+
+
+struct InflateChunk;
+
+
+//! Single-stream gzip file inflated on several threads
+// A plain gzip member is one deflate stream, so it cannot be cut at known
+// offsets like bgzf.  The stream is inflated in rounds: the first chunk of a
+// round starts at the exact position where the previous round stopped, the
+// other chunks search their slice of the compressed data for the start of a
+// dynamic huffman block and inflate from there against a placeholder window.
+// Every chunk must stop exactly where the next one started, otherwise the
+// round is redone on one thread.  Bytes copied out of the unknown window are
+// then re-inflated once the real window (the tail of the previous chunk) is
+// known, which in practice only touches the first few KB of each chunk.
+class SpeculativeGzipSource : public ByteSource {
+ public:
+  SpeculativeGzipSource(size_t threads);
+  ~SpeculativeGzipSource();
+
+  bool open(const char *file);
+  size_t read(char *buffer, size_t n);
+  bool failed() const { return m_failed; }
+
+ private:
+  MappedFile m_map;
+  ThreadPool m_pool;
+
+  std::vector<InflateChunk*> m_chunks;
+  size_t m_roundChunks;   //chunks holding output of the current round
+  size_t m_readChunk;     //chunk being handed out by read()
+  size_t m_readOffset;
+
+  size_t m_memberStart;   //byte offset of the deflate data of the current member
+  size_t m_bit;           //exact bit position in the member where the next round starts
+  std::vector<char> m_window;  //last 32KB inflated, the dictionary of the next round
+  unsigned long m_crc;
+  size_t m_memberSize;    //bytes inflated from the current member
+  size_t m_fallbacks;
+
+  bool m_memberEnd;
+  bool m_inputEnd;
+  bool m_failed;
+
+  bool startMember(size_t offset);
+  bool finishMember(size_t endBit);
+  bool nextRound();
+  size_t findSyncPoints(size_t startByte, size_t chunks);
+  bool sequentialRound(size_t roundEndBit);
+  void resolveChunks(size_t chunks);
+  void windowBefore(size_t chunk, std::vector<char> *window) const;
+};
+
+
+#endif
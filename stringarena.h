@@ -0,0 +1,82 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef STRINGARENA_H
+#define STRINGARENA_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+
+#define ARENA_FIRST_BLOCK (1 << 10)
+#define ARENA_MAX_BLOCK (1 << 20)
+
+
+//! Bump pointer storage for null terminated strings that all live as long as the arena
+// Strings are packed back to back in a few large blocks instead of one
+// malloc each, and are released together when the arena is destroyed.
+// Blocks double in size up to ARENA_MAX_BLOCK, so an arena holding only a
+// handful of strings stays small.
+class StringArena {
+ public:
+  StringArena() : m_next(0), m_end(0), m_blockSize(ARENA_FIRST_BLOCK), m_used(0), m_reserved(0) { }
+  ~StringArena() {
+    for (size_t i = 0; i < m_blocks.size(); i++)
+      free(m_blocks[i]);
+  }
+
+  //null terminated copy of text[0, length), 0 if no block could be allocated
+  const char *copy(const char *text, size_t length) {
+    char *s = allocate(length + 1);
+    if (0 == s)
+      return 0;
+
+    memcpy(s, text, length);
+    s[length] = 0;
+    return s;
+  }
+
+  //n bytes for the caller to fill, 0 if no block could be allocated
+  char *allocate(size_t n) {
+    if (n > (size_t) (m_end - m_next) && !addBlock(n))
+      return 0;
+
+    char *s = m_next;
+    m_next += n;
+    m_used += n;
+    return s;
+  }
+
+  size_t bytesUsed() const { return m_used; }          //string bytes, terminators included
+  size_t bytesReserved() const { return m_reserved; }  //bytes in allocated blocks
+
+ private:
+  std::vector<char*> m_blocks;
+  char *m_next;
+  char *m_end;
+  size_t m_blockSize;
+  size_t m_used;
+  size_t m_reserved;
+
+  bool addBlock(size_t minimum) {
+    size_t size = (minimum > m_blockSize) ? minimum : m_blockSize;
+    char *block = (char *) malloc(size);
+    if (0 == block)
+      return false;
+
+    m_blocks.push_back(block);
+    m_next = block;
+    m_end = block + size;
+    m_reserved += size;
+    if (m_blockSize < ARENA_MAX_BLOCK)
+      m_blockSize *= 2;
+    return true;
+  }
+
+  StringArena(const StringArena &);
+  StringArena &operator=(const StringArena &);
+};
+
+
+#endif
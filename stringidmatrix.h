@@ -0,0 +1,76 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef STRINGIDMATRIX_H
+#define STRINGIDMATRIX_H
+
+#include <stdint.h>
+
+#include "chunkedmatrix.h"
+
+
+//! Matrix of interned string ids, 32 bits per cell while loading, 16 bits once narrowed
+// Filled with set() while the rows are parsed; narrow() then moves the
+// cells to 16 bit storage when every id fits, which halves the largest
+// structure a load keeps. Rows are copied from the first one on, the 16 bit
+// chunks allocated as they are reached and each 32 bit chunk freed once
+// copied, so the peak stays near 4 bytes a cell rather than 6.
+class StringIdMatrix {
+ public:
+  StringIdMatrix() : m_narrowed(false) { }
+
+  void reset(size_t cols) {
+    m_wide.reset(cols);
+    m_narrow.reset(cols);
+    m_narrowed = false;
+  }
+
+  void resize(size_t rows) {
+    if (m_narrowed)
+      m_narrow.resize(rows);
+    else
+      m_wide.resize(rows);
+  }
+
+  size_t rows() const { return m_narrowed ? m_narrow.rows() : m_wide.rows(); }
+  size_t cols() const { return m_wide.cols(); }
+
+  //only before narrow()
+  void set(size_t i, size_t k, uint32_t id) { m_wide(i, k) = id; }
+
+  uint32_t operator()(size_t i, size_t k) const { return m_narrowed ? m_narrow(i, k) : m_wide(i, k); }
+
+  bool narrowed() const { return m_narrowed; }
+  size_t bytesPerCell() const { return m_narrowed ? sizeof(uint16_t) : sizeof(uint32_t); }
+
+  //switches to 16 bit cells when all ids are below idLimit and that fits, true if it did
+  bool narrow(uint64_t idLimit) {
+    if (m_narrowed || idLimit > 0x10000)
+      return false;
+
+    size_t rows = m_wide.rows();
+    size_t cols = m_wide.cols();
+    for (size_t i = 0; i < rows; i++) {
+      m_narrow.resize(i + 1);
+      const uint32_t *from = m_wide.row(i);
+      uint16_t *to = m_narrow.row(i);
+      for (size_t k = 0; k < cols; k++)
+        to[k] = (uint16_t) from[k];
+      m_wide.release(i + 1);
+    }
+    m_wide.clear();
+    m_narrowed = true;
+    return true;
+  }
+
+ private:
+  ChunkedMatrix<uint32_t> m_wide;
+  ChunkedMatrix<uint16_t> m_narrow;
+  bool m_narrowed;
+
+  StringIdMatrix(const StringIdMatrix &);
+  StringIdMatrix &operator=(const StringIdMatrix &);
+};
+
+
+#endif
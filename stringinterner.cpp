@@ -0,0 +1,222 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stringinterner.h"
+
+
+StringInterner::StringInterner()
+{
+  for (size_t s = 0; s < INTERN_SHARDS; s++) {
+    Shard &shard = m_shards[s];
+    shard.slots = (Slot *) calloc(INTERN_INITIAL_SLOTS, sizeof(Slot));
+    shard.mask = INTERN_INITIAL_SLOTS - 1;
+    pthread_rwlock_init(&shard.lock, 0);
+  }
+}
+
+
+StringInterner::~StringInterner()
+{
+  for (size_t s = 0; s < INTERN_SHARDS; s++) {
+    Shard &shard = m_shards[s];
+    free(shard.slots);
+    pthread_rwlock_destroy(&shard.lock);
+  }
+}
+
+
+size_t StringInterner::size() const
+{
+  size_t n = 0;
+  for (size_t s = 0; s < INTERN_SHARDS; s++)
+    n += m_shards[s].entries.size();
+  return n;
+}
+
+
+uint64_t StringInterner::idLimit() const
+{
+  uint64_t limit = 0;
+  for (size_t s = 0; s < INTERN_SHARDS; s++) {
+    size_t n = m_shards[s].entries.size();
+    if (0 == n)
+      continue;
+    uint64_t last = ((uint64_t) (n - 1) << INTERN_SHARD_BITS) | s;
+    if (last >= limit)
+      limit = last + 1;
+  }
+  return limit;
+}
+
+
+size_t StringInterner::bytesUsed() const
+{
+  size_t n = 0;
+  for (size_t s = 0; s < INTERN_SHARDS; s++)
+    n += m_shards[s].arena.bytesUsed();
+  return n;
+}
+
+
+size_t StringInterner::bytesReserved() const
+{
+  size_t n = 0;
+  for (size_t s = 0; s < INTERN_SHARDS; s++)
+    n += m_shards[s].arena.bytesReserved();
+  return n;
+}
+
+
+
+static inline uint64_t load64(const char *p)
+{
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+
+// multiply and shift over 8 byte words with a murmur3 style finish; the
+// per-sample strings are short, so this is a handful of multiplies each
+uint64_t StringInterner::hash(const char *text, size_t length)
+{
+  const uint64_t k1 = 0xff51afd7ed558ccdULL;
+  const uint64_t k2 = 0xc4ceb9fe1a85ec53ULL;
+
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ (length * k2);
+  size_t n = length;
+  for (; n >= 8; n -= 8, text += 8) {
+    h = (h ^ load64(text)) * k1;
+    h ^= h >> 29;
+  }
+  if (n > 0) {
+    uint64_t tail = 0;
+    memcpy(&tail, text, n);
+    h = (h ^ tail) * k2;
+  }
+
+  h ^= h >> 33;
+  h *= k1;
+  h ^= h >> 33;
+  h *= k2;
+  h ^= h >> 33;
+  return h;
+}
+
+
+
+bool StringInterner::find(const Shard &shard, const char *text, size_t length, uint64_t h, uint32_t *entry)
+{
+  uint32_t tag = (uint32_t) (h >> 32);
+  for (size_t i = h & shard.mask; ; i = (i + 1) & shard.mask) {
+    const Slot &slot = shard.slots[i];
+    if (0 == slot.entry)
+      return false;
+    if (slot.tag != tag)
+      continue;
+    const TextView &found = shard.entries[slot.entry - 1];
+    if (found.length == length && 0 == memcmp(found.ptr, text, length)) {
+      *entry = slot.entry - 1;
+      return true;
+    }
+  }
+}
+
+
+// doubles the slot array, kept at most 70% full so probe runs stay short
+bool StringInterner::grow(Shard *shard)
+{
+  size_t capacity = 2 * (shard->mask + 1);
+  Slot *slots = (Slot *) calloc(capacity, sizeof(Slot));
+  if (0 == slots)
+    return false;
+
+  for (size_t i = 0; i <= shard->mask; i++) {
+    const Slot &slot = shard->slots[i];
+    if (0 == slot.entry)
+      continue;
+    const TextView &text = shard->entries[slot.entry - 1];
+    size_t k = hash(text.ptr, text.length) & (capacity - 1);
+    while (0 != slots[k].entry)
+      k = (k + 1) & (capacity - 1);
+    slots[k] = slot;
+  }
+
+  free(shard->slots);
+  shard->slots = slots;
+  shard->mask = capacity - 1;
+  return true;
+}
+
+
+// text must not already be in the shard
+bool StringInterner::insert(Shard *shard, const char *text, size_t length, uint64_t h, uint32_t *entry)
+{
+  size_t count = shard->entries.size();
+  if (count == INTERN_SHARD_ENTRIES) {
+    fprintf(stderr, "ERROR more than %zu unique strings in one table shard\n", count);
+    return false;
+  }
+  if (10 * (count + 1) > 7 * (shard->mask + 1) && !grow(shard)) {
+    fprintf(stderr, "ERROR could not grow string table past %zu entries\n", count);
+    return false;
+  }
+
+  const char *copy = shard->arena.copy(text, length);
+  if (0 == copy) {
+    fprintf(stderr, "ERROR could not allocate string of length %zu\n", length);
+    return false;
+  }
+  shard->entries.push_back(TextView(copy, length));
+
+  size_t i = h & shard->mask;
+  while (0 != shard->slots[i].entry)
+    i = (i + 1) & shard->mask;
+
+  shard->slots[i].entry = (uint32_t) (count + 1);
+  shard->slots[i].tag = (uint32_t) (h >> 32);
+  *entry = (uint32_t) count;
+  return true;
+}
+
+
+
+bool StringInterner::intern(const char *text, size_t length, uint32_t *id, bool concurrent, bool *found)
+{
+  uint64_t h = hash(text, length);
+  size_t s = h >> (64 - INTERN_SHARD_BITS);
+  Shard &shard = m_shards[s];
+  uint32_t entry;
+  bool existing;
+  bool ok = true;
+
+  if (!concurrent) {
+    existing = find(shard, text, length, h, &entry);
+    if (!existing)
+      ok = insert(&shard, text, length, h, &entry);
+  }
+  else {
+    pthread_rwlock_rdlock(&shard.lock);
+    existing = find(shard, text, length, h, &entry);
+    pthread_rwlock_unlock(&shard.lock);
+
+    if (!existing) {
+      pthread_rwlock_wrlock(&shard.lock);
+      existing = find(shard, text, length, h, &entry);  //looked up again, another thread may have added it
+      if (!existing)
+        ok = insert(&shard, text, length, h, &entry);
+      pthread_rwlock_unlock(&shard.lock);
+    }
+  }
+
+  if (0 != found)
+    *found = existing;
+
+  if (!ok)
+    return false;
+  *id = (entry << INTERN_SHARD_BITS) | (uint32_t) s;
+  return true;
+}
@@ -0,0 +1,80 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef STRINGINTERNER_H
+#define STRINGINTERNER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "textview.h"
+#include "stringarena.h"
+
+
+#define INTERN_SHARD_BITS 6
+#define INTERN_SHARDS (1 << INTERN_SHARD_BITS)
+#define INTERN_INITIAL_SLOTS 64   //per shard, a power of two
+#define INTERN_SHARD_ENTRIES (1 << (32 - INTERN_SHARD_BITS))  //ids are 32 bits
+
+
+//! Set of unique strings, each kept once and numbered with a 32 bit id
+// Open addressing with linear probing over one contiguous slot array per
+// shard, so a lookup is a hash of the text and usually a single cache line
+// of slots. The top bits of the hash pick the shard; each shard has its own
+// lock, which is only taken when interning from several threads at once.
+// The strings themselves are packed into a per-shard StringArena and freed
+// all together with the interner.
+//
+// An id is the position of the string in its shard shifted up past the
+// shard number, so ids are handed out without any state shared between
+// shards and stay below 1 << 16 for tables of a few tens of thousands.
+class StringInterner {
+ public:
+  StringInterner();
+  ~StringInterner();
+
+  //id of text[0, length), the same id for equal text, false if the string
+  //could not be stored; concurrent must be set when other threads may be
+  //interning at the same time, found is set if the text was already there
+  bool intern(const char *text, size_t length, uint32_t *id, bool concurrent=false, bool *found=0);
+
+  //null terminated text of an id returned by intern()
+  TextView lookup(uint32_t id) const {
+    return m_shards[id & (INTERN_SHARDS - 1)].entries[id >> INTERN_SHARD_BITS];
+  }
+
+  size_t size() const;  //number of unique strings
+  uint64_t idLimit() const;  //one past the largest id handed out
+  size_t bytesUsed() const;      //string bytes, terminators included
+  size_t bytesReserved() const;  //arena bytes allocated to hold them
+
+  static uint64_t hash(const char *text, size_t length);
+
+ private:
+  struct Slot {
+    uint32_t entry;  //index into entries plus one, 0 when the slot is empty
+    uint32_t tag;    //upper hash bits, most mismatches end here without touching text
+  };
+
+  struct Shard {
+    Slot *slots;
+    size_t mask;       //slot count - 1
+    std::vector<TextView> entries;  //by id, in the order strings were added
+    pthread_rwlock_t lock;
+    StringArena arena;
+  };
+
+  Shard m_shards[INTERN_SHARDS];
+
+  static bool find(const Shard &shard, const char *text, size_t length, uint64_t h, uint32_t *entry);
+  static bool insert(Shard *shard, const char *text, size_t length, uint64_t h, uint32_t *entry);
+  static bool grow(Shard *shard);
+
+  StringInterner(const StringInterner &);
+  StringInterner &operator=(const StringInterner &);
+};
+
+
+#endif
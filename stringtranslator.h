@@ -11,12 +11,18 @@
 #include <string.h>
 #include <ctype.h>
 
+#include "textview.h"
+#include "numberparse.h"
+
 
 template <typename T>
 class StringTranslator {
  public:
   virtual ~StringTranslator() {}
   virtual T translate(const char *string)=0;
+
+  //a field of a line, by default through a null terminated copy
+  virtual T translate(const TextView &text) { return translate(text.str().c_str()); }
 };
 
 
@@ -33,7 +39,8 @@ class PlainTranslator : public StringTranslator<T> {
 template <>
 class PlainTranslator<int> : public StringTranslator<int> {
  public:
-  int translate(const char *string) { return atoi(string); }
+  int translate(const char *string) { return translate(TextView(string, strlen(string))); }
+  int translate(const TextView &text) { int value; parseInt(text, &value); return value; }
  private:
 };
 
@@ -41,7 +48,8 @@ class PlainTranslator<int> : public StringTranslator<int> {
 template <>
 class PlainTranslator<double> : public StringTranslator<double> {
  public:
-  double translate(const char *string) { return atof(string); }
+  double translate(const char *string) { return translate(TextView(string, strlen(string))); }
+  double translate(const TextView &text) { double value; parseDouble(text, &value); return value; }
  private:
 };
 
@@ -5,43 +5,148 @@
 from __future__ import print_function
 
 import os
+import re
+import subprocess
 import unittest
 
+from netCDF4 import Dataset
 
-import utils_vcf_format
-
-class ConvertTest(unittest.TestCase):
-    def test_1(self):
-        uf = utils_vcf_format.UtilsVCFFormat(1,1)
-
-        test_vcf = os.path.join(os.environ['HOME'], "tmp/test.vcf")
-        test_netcdf = os.path.join(os.environ['HOME'], "tmp/test.nc")
 
+import utils_vcf_format
 
-        uf.write_vcf(test_vcf)
-        os.system('rm ' + test_netcdf)
-        cmd = ' '.join([ "./vcf2nc",
-                             "-o", test_netcdf,
-                             "-i", test_vcf])
-        #print(cmd)
-        os.system(cmd)
-        self.assertTrue(uf.compare_variables(test_netcdf))
 
-    def test_2(self):
-        uf = utils_vcf_format.UtilsVCFFormat(10,20)
+TMP_DIR = os.path.join(os.environ['HOME'], "tmp")
 
-        test_vcf = os.path.join(os.environ['HOME'], "tmp/test.vcf")
-        test_netcdf = os.path.join(os.environ['HOME'], "tmp/test2.nc")
 
-        uf.write_vcf(test_vcf)
-        os.system('rm ' + test_netcdf)
-        cmd = ' '.join([ "./vcf2nc",
-                             "-o", test_netcdf,
-                             "-i", test_vcf])
-        #print(cmd)
-        os.system(cmd)
+class ConvertTest(unittest.TestCase):
+    def run_vcf2nc(self, test_vcf, name, *options):
+        """converts test_vcf into TMP_DIR/name, fails unless vcf2nc exits 0 and writes it, returns the file and the output"""
+        test_netcdf = os.path.join(TMP_DIR, name)
+        if os.path.exists(test_netcdf):
+            os.remove(test_netcdf)  # a stale file must not pass for a failed conversion
+
+        cmd = ["./vcf2nc", "-o", test_netcdf, "-i", test_vcf] + list(options)
+        process = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+        output = process.communicate()[0]
+        self.assertEqual(0, process.returncode, ' '.join(cmd) + "\n" + output)
+        self.assertTrue(os.path.exists(test_netcdf), ' '.join(cmd))
+        return test_netcdf, output
+
+    def convert(self, uf, test_vcf, name, *options):
+        """run_vcf2nc, then checks every variable against uf, returns the open dataset"""
+        test_netcdf = self.run_vcf2nc(test_vcf, name, *options)[0]
         self.assertTrue(uf.compare_variables(test_netcdf))
 
+        nc = Dataset(test_netcdf, 'r', format='NETCDF4')
+        self.addCleanup(nc.close)
+        return nc
 
+    def write_vcf(self, uf, final_newline=True):
+        test_vcf = os.path.join(TMP_DIR, "test.vcf")
+        uf.write_vcf(test_vcf, final_newline)
+        return test_vcf
 
+    def test_1(self):
+        uf = utils_vcf_format.UtilsVCFFormat(1,1)
+        self.convert(uf, self.write_vcf(uf), "test.nc")
 
+    def test_2(self):
+        uf = utils_vcf_format.UtilsVCFFormat(10,20)
+        self.convert(uf, self.write_vcf(uf), "test2.nc")
+
+    # mapped input, the last line also without a newline, which ends at the end of the mapping
+    def test_mapped_input(self):
+        uf = utils_vcf_format.UtilsVCFFormat(40,2000)
+        for final_newline in [True, False]:
+            test_vcf = self.write_vcf(uf, final_newline)
+            self.convert(uf, test_vcf, "test13.nc", "-mmap", "on")
+            self.convert(uf, test_vcf, "test13.nc", "-mmap", "on", "-threads", "4")
+
+    # the random likelihoods make nearly every cell unique, so after the first
+    # blocks the rows are stored raw, serially and by parallel ranges
+    def test_raw_rows(self):
+        uf = utils_vcf_format.UtilsVCFFormat(100,3000)
+        test_vcf = self.write_vcf(uf)
+        for threads in ["1", "8"]:
+            test_netcdf, output = self.run_vcf2nc(test_vcf, "test14.nc", "-threads", threads)
+            raw = re.search(r"(\d+) cells stored without lookup", output)
+            self.assertTrue(raw is not None and int(raw.group(1)) > 0, output)
+            self.assertTrue(uf.compare_variables(test_netcdf))
+
+    # enough blocks for several batches on each of the threads
+    def test_bgzf_input(self):
+        uf = utils_vcf_format.UtilsVCFFormat(40,2000)
+        test_vcf = os.path.join(TMP_DIR, "test.vcf.gz")
+        uf.write_vcf_bgzf(test_vcf)
+        self.convert(uf, test_vcf, "test3.nc", "-threads", "4")
+
+    # more than one buffer of compressed input
+    def test_gzip_input(self):
+        uf = utils_vcf_format.UtilsVCFFormat(40,2000)
+        test_vcf = os.path.join(TMP_DIR, "test.vcf.gz")
+        uf.write_vcf_gzip(test_vcf)
+        self.convert(uf, test_vcf, "test4.nc")
+
+    # about 10MB compressed, several speculative chunks in a single member and in each of two
+    def test_gzip_input_threads(self):
+        uf = utils_vcf_format.UtilsVCFFormat(40,18000)
+        test_vcf = os.path.join(TMP_DIR, "test.vcf.gz")
+        for members in [1, 2]:
+            uf.write_vcf_gzip(test_vcf, members)
+            self.assertTrue(os.path.getsize(test_vcf) > 2 * (4 << 20))  # SPECULATIVE_CHUNK_SIZE
+            self.convert(uf, test_vcf, "test5.nc", "-threads", "4")
+
+    # more than one 16MB parse block, each cut into many ranges
+    def test_parallel_parse(self):
+        uf = utils_vcf_format.UtilsVCFFormat(40,15000)
+        self.convert(uf, self.write_vcf(uf), "test6.nc", "-threads", "8")
+
+    # few lines, each split into slices across the threads
+    def test_wide_lines(self):
+        uf = utils_vcf_format.UtilsVCFFormat(3000,5)
+        self.convert(uf, self.write_vcf(uf), "test7.nc", "-threads", "8")
+
+    def test_alternate_header(self):
+        uf = utils_vcf_format.UtilsVCFFormat(10,20)
+        test_vcf = self.write_vcf(uf)
+        test_header = os.path.join(TMP_DIR, "test_header.vcf")
+        with open(test_header, "w") as f_out:
+            uf.write_header(f_out)
+        self.convert(uf, test_vcf, "test8.nc", "-alt", test_header)
+
+    # sample ranges wider than a transpose tile, and several blocks of more than a tile of snps
+    def test_decode_format(self):
+        uf = utils_vcf_format.UtilsVCFFormat(600,300)
+        self.convert(uf, self.write_vcf(uf), "test9.nc", "-decode", "on", "-maxmem", "1", "-threads", "2")
+
+    # many blocks, with one sample range over all samples and with several
+    def test_blocked_writes(self):
+        uf = utils_vcf_format.UtilsVCFFormat(200,5000)
+        test_vcf = self.write_vcf(uf)
+        self.convert(uf, test_vcf, "test10.nc", "-maxmem", "1")
+        self.convert(uf, test_vcf, "test10.nc", "-maxmem", "1", "-threads", "4")
+
+    def test_snp_major(self):
+        uf = utils_vcf_format.UtilsVCFFormat(600,300)
+        test_vcf = self.write_vcf(uf)
+        nc = self.convert(uf, test_vcf, "test11.nc", "-snpmajor", "all", "-maxmem", "4", "-threads", "2")
+        self.assertEqual(("SNPs", "Samples", "arb3"), nc.variables["array_GT"].dimensions)
+        self.assertEqual(("SNPs", "Samples"), nc.variables["array_RD"].dimensions)
+        self.assertEqual("SNPs,Samples", nc.getncattr("genotype_layout"))
+        self.assertEqual("SNPs,Samples", nc.getncattr("format_layout"))
+
+        nc = self.convert(uf, test_vcf, "test11d.nc", "-snpmajor", "format", "-decode", "on", "-maxmem", "1", "-threads", "2")
+        self.assertEqual(("Samples", "SNPs", "arb3"), nc.variables["array_GT"].dimensions)
+        self.assertEqual(("SNPs", "Samples", "arb3"), nc.variables["array_PL"].dimensions)
+
+    def test_storage(self):
+        uf = utils_vcf_format.UtilsVCFFormat(20,5000)
+        nc = self.convert(uf, self.write_vcf(uf), "test12.nc",
+                          "-storage", "genotypes chunk=8x1000 deflate=4 shuffle=on; all deflate=1",
+                          "-threads", "4")
+        self.assertEqual([8, 1000, 3], nc.variables["array_GT"].chunking())
+        self.assertEqual(4, nc.variables["array_GT"].filters()['complevel'])
+        self.assertTrue(nc.variables["array_GT"].filters()['shuffle'])
+        self.assertEqual(1, nc.variables["array_RD"].filters()['complevel'])
+        self.assertEqual(1, nc.variables["Position"].filters()['complevel'])
+        self.assertEqual('contiguous', nc.variables["ID"].chunking())
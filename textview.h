@@ -0,0 +1,46 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef TEXTVIEW_H
+#define TEXTVIEW_H
+
+#include <string.h>
+#include <string>
+
+
+//! Pointer and length into text owned by someone else, not null terminated
+// Used to tokenize input lines without copying, only values that outlive
+// the line (or the mapped file) are copied out with str().
+struct TextView {
+  const char *ptr;
+  size_t length;
+
+  TextView() : ptr(0), length(0) { }
+  TextView(const char *p, size_t n) : ptr(p), length(n) { }
+
+  std::string str() const { return std::string(ptr, length); }
+
+  bool equals(const char *s) const {
+    return 0 == strncmp(ptr, s, length) && 0 == s[length];
+  }
+
+  //orders like std::string comparison
+  int compare(const char *s, size_t n) const {
+    int c = memcmp(ptr, s, (length < n) ? length : n);
+    if (0 != c)
+      return c;
+    return (length < n) ? -1 : (length > n);
+  }
+
+  //copy into a caller supplied buffer with a null terminator, truncating to fit
+  const char *copy(char *buffer, size_t size) const {
+    size_t n = (length < size) ? length : size-1;
+    memcpy(buffer, ptr, n);
+    buffer[n] = 0;
+    return buffer;
+  }
+};
+
+
+
+#endif
@@ -0,0 +1,103 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "threadpool.h"
+
+
+ThreadPool::ThreadPool(size_t threads)
+{
+  m_nThreads = (threads < 1) ? 1 : threads;
+  m_running = 0;
+  m_shutdown = false;
+
+  pthread_mutex_init(&m_mutex, 0);
+  pthread_cond_init(&m_workReady, 0);
+  pthread_cond_init(&m_workDone, 0);
+
+  m_threads = new pthread_t[m_nThreads];
+  for (size_t i = 0; i < m_nThreads; i++) {
+    if (0 != pthread_create(&m_threads[i], 0, threadMain, this)) {
+      fprintf(stderr, "ERROR could not start worker thread %zu\n", i);
+      exit(-1);
+    }
+  }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+  pthread_mutex_lock(&m_mutex);
+  m_shutdown = true;
+  pthread_cond_broadcast(&m_workReady);
+  pthread_mutex_unlock(&m_mutex);
+
+  for (size_t i = 0; i < m_nThreads; i++)
+    pthread_join(m_threads[i], 0);
+  delete[] m_threads;
+
+  pthread_cond_destroy(&m_workDone);
+  pthread_cond_destroy(&m_workReady);
+  pthread_mutex_destroy(&m_mutex);
+}
+
+
+void *ThreadPool::threadMain(void *arg)
+{
+  ((ThreadPool *) arg)->workerLoop();
+  return 0;
+}
+
+
+void ThreadPool::workerLoop()
+{
+  pthread_mutex_lock(&m_mutex);
+  while (true) {
+    while (m_queue.empty() && !m_shutdown)
+      pthread_cond_wait(&m_workReady, &m_mutex);
+    if (m_queue.empty())  //shutting down and nothing left
+      break;
+
+    WorkerTask *task = m_queue.front();
+    m_queue.pop_front();
+    m_running++;
+    pthread_mutex_unlock(&m_mutex);
+
+    task->run();
+
+    pthread_mutex_lock(&m_mutex);
+    task->m_done = true;
+    m_running--;
+    pthread_cond_broadcast(&m_workDone);
+  }
+  pthread_mutex_unlock(&m_mutex);
+}
+
+
+void ThreadPool::submit(WorkerTask *task)
+{
+  pthread_mutex_lock(&m_mutex);
+  task->m_done = false;
+  m_queue.push_back(task);
+  pthread_cond_signal(&m_workReady);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+
+void ThreadPool::wait(WorkerTask *task)
+{
+  pthread_mutex_lock(&m_mutex);
+  while (!task->m_done)
+    pthread_cond_wait(&m_workDone, &m_mutex);
+  pthread_mutex_unlock(&m_mutex);
+}
+
+
+void ThreadPool::waitAll()
+{
+  pthread_mutex_lock(&m_mutex);
+  while (!m_queue.empty() || m_running > 0)
+    pthread_cond_wait(&m_workDone, &m_mutex);
+  pthread_mutex_unlock(&m_mutex);
+}
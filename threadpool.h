@@ -0,0 +1,60 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <deque>
+
+
+//! Unit of work handed to a ThreadPool
+class WorkerTask {
+ public:
+  WorkerTask() : m_done(false) { }
+  virtual ~WorkerTask() { }
+  virtual void run()=0;
+
+ private:
+  friend class ThreadPool;
+  bool m_done;  //guarded by the pool mutex
+};
+
+
+
+//! Fixed set of pthreads running submitted tasks in submission order
+// The pool does not own the tasks, the caller keeps them alive until wait()
+// or waitAll() says they are finished.
+class ThreadPool {
+ public:
+  ThreadPool(size_t threads);
+  ~ThreadPool();
+
+  size_t threads() const { return m_nThreads; }
+
+  void submit(WorkerTask *task);
+  void wait(WorkerTask *task);
+  void waitAll();
+
+ private:
+  pthread_t *m_threads;
+  size_t m_nThreads;
+
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_workReady;
+  pthread_cond_t m_workDone;
+
+  std::deque<WorkerTask*> m_queue;
+  size_t m_running;
+  bool m_shutdown;
+
+  static void *threadMain(void *arg);
+  void workerLoop();
+
+  ThreadPool(const ThreadPool &);
+  ThreadPool &operator=(const ThreadPool &);
+};
+
+
+#endif
@@ -0,0 +1,118 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+// Per cell cost of translating FORMAT values the way storeMatrix does, once
+// through the virtual StringTranslator interface with the value count known
+// at run time, the way it used to, and once with the translator as a
+// template policy and the value count fixed at compile time. The two stay
+// within a few ns of each other from run to run, so FormatDecoder keeps the
+// virtual translator; this is kept to check that again.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+#include "stringtranslator.h"
+#include "delimiterscan.h"
+
+
+#define BENCH_CELLS (1 << 20)
+#define BENCH_ROUNDS 8
+
+
+static double wallSeconds()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+
+template <typename T>
+static void translateVirtual(const std::vector<TextView> &cells, size_t factor, StringTranslator<T> *translator, T *out)
+{
+  std::vector<TextView> values;
+  for (size_t k = 0; k < cells.size(); k++) {
+    if (1 == factor) {
+      out[k] = translator->translate( cells[k] );
+      continue;
+    }
+    size_t found = splitView(cells[k], ',', &values);
+    for (size_t m = 0; m < factor; m++)
+      out[k*factor + m] = (m < found) ? translator->translate( values[m] ) : translator->translate( "" );
+  }
+}
+
+
+template <typename T, typename Translator, int FACTOR>
+static void translatePolicy(const std::vector<TextView> &cells, Translator translator, T *out)
+{
+  std::vector<TextView> values;
+  for (size_t k = 0; k < cells.size(); k++) {
+    if (1 == FACTOR) {
+      out[k] = translator.translate( cells[k] );
+      continue;
+    }
+    size_t found = splitView(cells[k], ',', &values);
+    for (size_t m = 0; m < FACTOR; m++)
+      out[k*FACTOR + m] = (m < found) ? translator.translate( values[m] ) : translator.translate( "" );
+  }
+}
+
+
+// cells of factor comma separated values, like DP (1), AD (2) or PL (3)
+static void makeCells(size_t factor, bool decimals, std::vector<std::string> *text, std::vector<TextView> *cells)
+{
+  srand(17);
+  text->resize(BENCH_CELLS);
+  cells->resize(BENCH_CELLS);
+  for (size_t k = 0; k < BENCH_CELLS; k++) {
+    std::string &s = (*text)[k];
+    for (size_t m = 0; m < factor; m++) {
+      char value[32];
+      if (decimals)
+        snprintf(value, 32, "%s%.4f", (0 == m) ? "" : ",", rand() / (double) RAND_MAX);
+      else
+        snprintf(value, 32, "%s%d", (0 == m) ? "" : ",", rand() % 1000);
+      s.append(value);
+    }
+    (*cells)[k] = TextView(s.data(), s.size());
+  }
+}
+
+
+template <typename T, int FACTOR>
+static void bench(const char *label, bool decimals)
+{
+  std::vector<std::string> text;
+  std::vector<TextView> cells;
+  makeCells(FACTOR, decimals, &text, &cells);
+  std::vector<T> a(BENCH_CELLS * FACTOR), b(BENCH_CELLS * FACTOR);
+
+  PlainTranslator<T> translator;
+  double start = wallSeconds();
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+    translateVirtual<T>(cells, FACTOR, &translator, &a[0]);
+  double before = (wallSeconds() - start) / (BENCH_ROUNDS * (double) BENCH_CELLS) * 1e9;
+
+  start = wallSeconds();
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+    translatePolicy<T, PlainTranslator<T>, FACTOR>(cells, translator, &b[0]);
+  double after = (wallSeconds() - start) / (BENCH_ROUNDS * (double) BENCH_CELLS) * 1e9;
+
+  printf("%-12s virtual %6.1f ns/cell  policy %6.1f ns/cell  %s\n", label, before, after,
+         (a == b) ? "same values" : "VALUES DIFFER");
+}
+
+
+int main(int argc, char *argv[])
+{
+  printf("%d cells x %d rounds, delimiter scan %s\n", BENCH_CELLS, BENCH_ROUNDS, delimiterScanISA());
+  bench<int, 1>("int x1", false);
+  bench<int, 2>("int x2", false);
+  bench<int, 3>("int x3", false);
+  bench<double, 1>("double x1", true);
+  bench<double, 3>("double x3", true);
+  return 0;
+}
@@ -0,0 +1,46 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef TRANSPOSE_H
+#define TRANSPOSE_H
+
+#include <stddef.h>
+
+
+#define TRANSPOSE_TILE 32  //snps and samples on each side of a tile
+
+
+// Rows of snps, factor values per sample, into samples x snps x factor for
+// samples [firstSample, lastSample).  Walking all snps of one sample reads a
+// value from every row, a cache line and for wide cohorts a page each, and
+// walking all samples of one snp writes every value nSNPs*factor apart.  A
+// tile of TRANSPOSE_TILE snps by TRANSPOSE_TILE samples touches few enough
+// lines on both sides to keep them in cache until they are used up.
+template <typename T, int FACTOR, typename Matrix>
+static void transposeTiled(const Matrix &in, size_t firstSNP, size_t nSNPs, size_t firstSample, size_t lastSample,
+                           size_t factor, T *out)
+{
+  const size_t f = (0 != FACTOR) ? FACTOR : factor;
+  const T *rows[TRANSPOSE_TILE];
+
+  for (size_t i0 = 0; i0 < nSNPs; i0 += TRANSPOSE_TILE) {
+    size_t i1 = (i0 + TRANSPOSE_TILE < nSNPs) ? i0 + TRANSPOSE_TILE : nSNPs;
+    for (size_t i = i0; i < i1; i++)
+      rows[i - i0] = in.row(firstSNP + i);
+
+    for (size_t k0 = firstSample; k0 < lastSample; k0 += TRANSPOSE_TILE) {
+      size_t k1 = (k0 + TRANSPOSE_TILE < lastSample) ? k0 + TRANSPOSE_TILE : lastSample;
+      for (size_t k = k0; k < k1; k++) {
+        T *o = out + k*(nSNPs * f) + i0*f;
+        for (size_t i = i0; i < i1; i++) {
+          const T *v = rows[i - i0] + k*f;
+          for (size_t m = 0; m < f; m++)
+            *o++ = v[m];
+        }
+      }
+    }
+  }
+}
+
+
+#endif
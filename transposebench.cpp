@@ -0,0 +1,83 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+// Per value cost of transposing a decoded FORMAT column, snps x (samples *
+// factor), into the samples x snps x factor order variables are written in,
+// once a whole sample at a time the way storeDecoded used to and once tile
+// by tile, for cohorts of different widths holding the same number of values.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <vector>
+
+#include "chunkedmatrix.h"
+#include "transpose.h"
+
+
+#define BENCH_VALUES (1 << 24)
+#define BENCH_ROUNDS 4
+
+
+static double wallSeconds()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+
+template <typename T, int FACTOR>
+static void transposeBySample(const ChunkedMatrix<T> &in, size_t nSNPs, size_t nSamples, T *out)
+{
+  for (size_t k = 0; k < nSamples; k++) {
+    T *o = out + k*(nSNPs * FACTOR);
+    for (size_t i = 0; i < nSNPs; i++) {
+      for (size_t m = 0; m < FACTOR; m++)
+        o[ i*FACTOR + m] = in(i, k*FACTOR + m);
+    }
+  }
+}
+
+
+template <typename T, int FACTOR>
+static void bench(const char *label, size_t nSamples)
+{
+  size_t nSNPs = BENCH_VALUES / (nSamples * FACTOR);
+  ChunkedMatrix<T> in;
+  in.reset(nSamples * FACTOR);
+  in.resize(nSNPs);
+  srand(17);
+  for (size_t i = 0; i < nSNPs; i++) {
+    T *row = in.row(i);
+    for (size_t k = 0; k < nSamples * FACTOR; k++)
+      row[k] = (T) (rand() % 1000);
+  }
+  std::vector<T> a(nSNPs * nSamples * FACTOR), b(nSNPs * nSamples * FACTOR);
+
+  double start = wallSeconds();
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+    transposeBySample<T, FACTOR>(in, nSNPs, nSamples, &a[0]);
+  double before = (wallSeconds() - start) / (BENCH_ROUNDS * (double) a.size()) * 1e9;
+
+  start = wallSeconds();
+  for (int r = 0; r < BENCH_ROUNDS; r++)
+    transposeTiled<T, FACTOR>(in, 0, nSNPs, 0, nSamples, FACTOR, &b[0]);
+  double after = (wallSeconds() - start) / (BENCH_ROUNDS * (double) b.size()) * 1e9;
+
+  printf("%-12s %7zu samples x %7zu snps  by sample %5.2f ns/value  tiled %5.2f ns/value  %s\n", label, nSamples, nSNPs,
+         before, after, (a == b) ? "same values" : "VALUES DIFFER");
+}
+
+
+int main(int argc, char *argv[])
+{
+  printf("%d values x %d rounds, tiles of %d\n", BENCH_VALUES, BENCH_ROUNDS, TRANSPOSE_TILE);
+  size_t widths[] = { 100, 1000, 10000, 100000 };
+  for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); w++) {
+    bench<signed char, 2>("genotype", widths[w]);
+    bench<int, 1>("int x1", widths[w]);
+    bench<int, 3>("int x3", widths[w]);
+    bench<double, 1>("double x1", widths[w]);
+  }
+  return 0;
+}
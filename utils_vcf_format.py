@@ -5,7 +5,9 @@
 from __future__ import print_function
 
 import argparse
-import gzip
+import os
+import struct
+import zlib
 
 
 from math import *
@@ -81,7 +83,7 @@ class UtilsVCFFormat:
             f_out.write("\t" + self.sample_id[i]);
         f_out.write( "\n");
 
-    def write_vcf(self, output_file):
+    def write_vcf(self, output_file, final_newline=True):
         f_out = open(output_file, "w")
         self.write_header(f_out)
 
@@ -119,10 +121,45 @@ class UtilsVCFFormat:
                              self.likelihoodAA[i,k],
                              self.likelihoodAB[i,k],
                              self.likelihoodBB[i,k]))
-            f_out.write("\n")
+            if final_newline or k + 1 < self.n_snps:
+                f_out.write("\n")
         f_out.close()
 
 
+    def write_vcf_bgzf(self, output_file, block_size=65280):
+        """write the vcf as bgzip style blocks, each block a complete gzip member"""
+        plain_file = output_file + ".tmp"
+        self.write_vcf(plain_file)
+        with open(plain_file, "rb") as f_in:
+            data = f_in.read()
+        os.remove(plain_file)
+
+        def bgzf_block(chunk):
+            c = zlib.compressobj(6, zlib.DEFLATED, -15)
+            cdata = c.compress(chunk) + c.flush()
+            header = struct.pack('<BBBBIBBHBBHH', 31, 139, 8, 4, 0, 0, 255, 6, 66, 67, 2, len(cdata) + 25)
+            return header + cdata + struct.pack('<II', zlib.crc32(chunk) & 0xffffffff, len(chunk))
+
+        with open(output_file, "wb") as f_out:
+            for i in range(0, len(data), block_size):
+                f_out.write(bgzf_block(data[i:i+block_size]))
+            f_out.write(bgzf_block(b''))  # end of file marker
+
+    def write_vcf_gzip(self, output_file, members=1):
+        """write the vcf gzip compressed, cut into members that follow each other in the file"""
+        plain_file = output_file + ".tmp"
+        self.write_vcf(plain_file)
+        with open(plain_file, "rb") as f_in:
+            data = f_in.read()
+        os.remove(plain_file)
+
+        step = (len(data) + members - 1) // members
+        with open(output_file, "wb") as f_out:
+            for i in range(0, len(data), step):
+                c = zlib.compressobj(6, zlib.DEFLATED, 31)  # 31 for the gzip header and trailer
+                f_out.write(c.compress(data[i:i+step]) + c.flush())
+
+
     def compare_vector(self, input_netcdf, varname, b, epsilon=None):
         input_ncvars = Dataset(input_netcdf, 'r', format='NETCDF4')
         a = input_ncvars.variables[varname][:]
@@ -161,24 +198,27 @@ class UtilsVCFFormat:
 
     def compare_matrix_values(self, a, b, epsilon=None, msg=None):
         msg="" if None == msg else " " + msg
+        # whole matrices at once, the larger fixtures are too slow a cell at a time
         if None == epsilon:
-            for i in range(a.shape[0]):
-                for j in range(a.shape[1]):
-                    if a[i,j] != b[i,j]:
-                        print("ERROR compare failed at index {i},{j}: {a} vs {b}{msg}".format(i=i,j=j,a=a[i,j], b=b[i,j], msg=msg))
-                        return False
-
+            failed = np.argwhere(a != b)
         else:
-            for i in range(a.shape[0]):
-                for j in range(a.shape[1]):
-                    if np.abs(a[i,j] -  b[i,j]) > epsilon:
-                        print("ERROR compare failed at index {i},{j}: {a} vs {b}{msg}".format(i=i,j=j,a=a[i,j],b=b[i,j], msg=msg))
-                        return False
+            failed = np.argwhere(np.abs(a - b) > epsilon)
+        if len(failed) > 0:
+            i, j = failed[0]
+            print("ERROR compare failed at index {i},{j}: {a} vs {b}{msg}".format(i=i,j=j,a=a[i,j], b=b[i,j], msg=msg))
+            return False
         return True
 
+    # per-sample variables as Samples x SNPs, whichever order they were stored in
+    def sample_major(self, variable):
+        a = variable[:]
+        if "SNPs" == variable.dimensions[0]:
+            a = np.swapaxes(a, 0, 1)
+        return a
+
     def compare_matrix(self, input_netcdf, varname, b, epsilon=None):
         input_ncvars = Dataset(input_netcdf, 'r', format='NETCDF4')
-        a = input_ncvars.variables[varname][:]
+        a = self.sample_major(input_ncvars.variables[varname])
 
         if a.shape != b.shape:
             print("ERROR different sizes {a} {b}".format(a=a.shape, b=b.shape))
@@ -192,7 +232,7 @@ class UtilsVCFFormat:
 
     def compare_three_matrix(self, input_netcdf, varname, A, B, C, epsilon=None):
         input_ncvars = Dataset(input_netcdf, 'r', format='NETCDF4')
-        a = input_ncvars.variables[varname][:]
+        a = self.sample_major(input_ncvars.variables[varname])
 
         shape = (a.shape[0], a.shape[1])
         if shape != A.shape or shape != B.shape or shape != C.shape or 3 != a.shape[2]:
@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <sys/time.h>
+#include <vector>
 
 #include "utilsnetcdf.h"
 
@@ -157,15 +159,21 @@ bool UtilsNetcdf::inquireVectorDoubleVariable(int *varid, size_t *nRows, int nci
 
 
 
+// the first two dimensions decide, so Samples x SNPs x arbN variables are handled too
 bool UtilsNetcdf::inquireMatrixStorage(bool *SamplebySNPs, int varid, int ncid)
 {
   int nret;
   const int expectedDims = 2;
 
-  int dimids[expectedDims];
-  nret = nc_inq_var(ncid, varid, 0, 0, 0, dimids, 0);
+  int nDims;
+  int dimids[NC_MAX_VAR_DIMS];
+  nret = nc_inq_var(ncid, varid, 0, 0, &nDims, dimids, 0);
   FALSE_ON_NETCDF_ERROR(nret, "ERROR could not read information about variable id %i\n", varid);
 
+  if (nDims < expectedDims) {
+    fprintf(stderr, "ERROR expected at least %i dimensions for variable id %i, found %i\n", expectedDims, varid, nDims);
+    return false;
+  }
 
   char names[expectedDims][NC_MAX_NAME+1]; //row major order
 
@@ -185,7 +193,7 @@ bool UtilsNetcdf::inquireMatrixStorage(bool *SamplebySNPs, int varid, int ncid)
     return true;
   }
 
-  fprintf(stderr, "one or both dimension names are unknown %s, %s", names[0], names[1]);
+  fprintf(stderr, "ERROR one or both dimension names are unknown %s, %s\n", names[0], names[1]);
 
   return false;
 }
@@ -440,33 +448,104 @@ int get_var<float>(int ncid, int varid, float *tp)
 }
 
 
+struct WriteStats {
+  WriteStats() : bytes(0), seconds(0) { }
+  size_t bytes;
+  double seconds;
+};
+
+static std::vector<WriteStats> writeStatsByVariable;  //written from one thread only, like the file
+
+
+static double wallSeconds()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+
+//! Adds the time until it goes out of scope, and the values written, to the stats of a variable
+// Without count the whole variable is written.
+class WriteTimer {
+ public:
+  WriteTimer(int ncid, int varid, const size_t count[], size_t valueSize) : m_varid(varid), m_start(wallSeconds()) {
+    int nDims = 0;
+    int dimids[NC_MAX_VAR_DIMS];
+    m_bytes = valueSize;
+    if (NC_NOERR != nc_inq_var(ncid, varid, 0, 0, &nDims, dimids, 0))
+      nDims = 0;
+    for (int i = 0; i < nDims; i++) {
+      size_t length = 0;
+      if (0 == count)
+        nc_inq_dim(ncid, dimids[i], 0, &length);
+      m_bytes *= (0 == count) ? length : count[i];
+    }
+  }
+
+  ~WriteTimer() {
+    if (m_varid < 0)
+      return;
+    if ((size_t) m_varid >= writeStatsByVariable.size())
+      writeStatsByVariable.resize(m_varid + 1);
+    writeStatsByVariable[m_varid].bytes += m_bytes;
+    writeStatsByVariable[m_varid].seconds += wallSeconds() - m_start;
+  }
+
+  void bytes(size_t n) { m_bytes = n; }
+  size_t bytes() const { return m_bytes; }
+
+ private:
+  int m_varid;
+  double m_start;
+  size_t m_bytes;
+};
+
+
+void UtilsNetcdf::writeStats(int varid, size_t *bytes, double *seconds)
+{
+  *bytes = 0;
+  *seconds = 0;
+  if (varid >= 0 && (size_t) varid < writeStatsByVariable.size()) {
+    *bytes = writeStatsByVariable[varid].bytes;
+    *seconds = writeStatsByVariable[varid].seconds;
+  }
+}
+
+
+
 template<>
 int put_var<char>(int ncid, int varid, const char *tp)
 {
+  WriteTimer timer(ncid, varid, 0, sizeof(char));
   return nc_put_var_text(ncid, varid, tp);
 }
 
 template<>
 int put_var<unsigned char>(int ncid, int varid, const unsigned char *tp)
 {
+  WriteTimer timer(ncid, varid, 0, sizeof(unsigned char));
   return nc_put_var_uchar(ncid, varid, tp);
 }
 
 template<>
 int put_var<signed char>(int ncid, int varid, const signed char *tp)
 {
+  WriteTimer timer(ncid, varid, 0, sizeof(signed char));
   return nc_put_var_schar(ncid, varid, tp);
 }
 
 template<>
 int put_var<int>(int ncid, int varid, const int *tp)
 {
+  WriteTimer timer(ncid, varid, 0, sizeof(int));
   return nc_put_var_int(ncid, varid, tp);
 }
 
 template<>
 int put_var<double>(int ncid, int varid, const double *tp)
 {
+  WriteTimer timer(ncid, varid, 0, sizeof(double));
   return nc_put_var_double(ncid, varid, tp);
 }
 
@@ -474,6 +553,7 @@ int put_var<double>(int ncid, int varid, const double *tp)
 template<>
 int put_var<float>(int ncid, int varid, const float *tp)
 {
+  WriteTimer timer(ncid, varid, 0, sizeof(float));
   return nc_put_var_float(ncid, varid, tp);
 }
 
@@ -520,43 +600,52 @@ int get_vara<float>(int ncid, int varid, const size_t start[], const size_t coun
 template<>
 int put_vara<char>(int ncid, int varid, const size_t start[], const size_t count[],  const char *tp)
 {
+  WriteTimer timer(ncid, varid, count, sizeof(char));
   return nc_put_vara_text(ncid, varid, start, count, tp);
 }
 
 template<>
 int put_vara<unsigned char>(int ncid, int varid, const size_t start[], const size_t count[],  const unsigned char *tp)
 {
+  WriteTimer timer(ncid, varid, count, sizeof(unsigned char));
   return nc_put_vara_uchar(ncid, varid, start, count, tp);
 }
 
 template<>
 int put_vara<signed char>(int ncid, int varid, const size_t start[], const size_t count[],  const signed char *tp)
 {
+  WriteTimer timer(ncid, varid, count, sizeof(signed char));
   return nc_put_vara_schar(ncid, varid, start, count, tp);
 }
 
 template<>
 int put_vara<int>(int ncid, int varid, const size_t start[], const size_t count[],  const int *tp)
 {
+  WriteTimer timer(ncid, varid, count, sizeof(int));
   return nc_put_vara_int(ncid, varid, start, count, tp);
 }
 
 template<>
 int put_vara<double>(int ncid, int varid, const size_t start[], const size_t count[],  const double *tp)
 {
+  WriteTimer timer(ncid, varid, count, sizeof(double));
   return nc_put_vara_double(ncid, varid, start, count, tp);
 }
 
 template<>
 int put_vara<float>(int ncid, int varid, const size_t start[], const size_t count[],  const float *tp)
 {
+  WriteTimer timer(ncid, varid, count, sizeof(float));
   return nc_put_vara_float(ncid, varid, start, count, tp);
 }
 
-
-
-
-
-
-
-
+template<>
+int put_vara<const char *>(int ncid, int varid, const size_t start[], const size_t count[],  const char * const *tp)
+{
+  WriteTimer timer(ncid, varid, count, sizeof(char *));
+  size_t bytes = 0;
+  for (size_t i = 0; i < timer.bytes() / sizeof(char *); i++)
+    bytes += strlen(tp[i]) + 1;
+  timer.bytes(bytes);
+  return nc_put_vara_string(ncid, varid, start, count, (const char **) tp);
+}
@@ -45,6 +45,9 @@ class UtilsNetcdf
 
   static bool inquireMatrixStorage(bool *SamplebySNPs, int varid, int ncid);
 
+  //bytes handed to put_var and put_vara for varid, and the seconds those calls took
+  static void writeStats(int varid, size_t *bytes, double *seconds);
+
   static bool load(sspt_Array< int > *vec, int ncid, const char *variable);
   static bool load(sspt_Array<const char *> *vec, char **buffer, int ncid, const char *variable);
   static bool loadString(sspt_Array<const char *> *vec, char **buffer, int ncid, const char *variable);
@@ -116,6 +119,7 @@ template<> int put_vara<signed char>(int ncid, int varid, const size_t start[],
 template<> int put_vara<int>(int ncid, int varid, const size_t start[], const size_t count[],  const int *tp);
 template<> int put_vara<double>(int ncid, int varid, const size_t start[], const size_t count[],  const double *tp);
 template<> int put_vara<float>(int ncid, int varid, const size_t start[], const size_t count[],  const float *tp);
+template<> int put_vara<const char *>(int ncid, int varid, const size_t start[], const size_t count[],  const char * const *tp);
 
 
 
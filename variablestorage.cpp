@@ -0,0 +1,96 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "variablestorage.h"
+#include "delimiterscan.h"
+
+
+// non-negative decimal that is the whole of the view
+static bool parseUnsigned(const TextView &view, unsigned long *value)
+{
+  if (0 == view.length || view.length > 18)
+    return false;
+  unsigned long n = 0;
+  for (size_t i = 0; i < view.length; i++) {
+    if (view.ptr[i] < '0' || view.ptr[i] > '9')
+      return false;
+    n = 10 * n + (view.ptr[i] - '0');
+  }
+  *value = n;
+  return true;
+}
+
+
+static bool sameText(const TextView &view, const char *text)
+{
+  return view.length == strlen(text) && 0 == memcmp(view.ptr, text, view.length);
+}
+
+
+bool VariableStorage::parse(const char *settings)
+{
+  VariableStorage result = *this;
+  std::vector<TextView> words;
+  std::vector<TextView> parts;
+  splitViewAny(TextView(settings, strlen(settings)), " \t\r\n", &words);
+
+  for (size_t i = 0; i < words.size(); i++) {
+    if (0 == words[i].length)
+      continue;
+    splitView(words[i], '=', &parts);
+    std::string word(words[i].ptr, words[i].length);
+    if (2 != parts.size()) {
+      fprintf(stderr, "ERROR expected key=value for storage setting %s\n", word.c_str());
+      return false;
+    }
+
+    const TextView &key = parts[0];
+    TextView value = parts[1];
+    unsigned long n = 0;
+    bool ok = true;
+    if (sameText(key, "deflate")) {
+      ok = parseUnsigned(value, &n) && n <= 9;
+      result.deflate = n;
+    }
+    else if (sameText(key, "shuffle")) {
+      ok = sameText(value, "on") || sameText(value, "off");
+      result.shuffle = sameText(value, "on");
+    }
+    else if (sameText(key, "chunk")) {
+      splitView(value, 'x', &parts);
+      ok = parts.size() <= STORAGE_MAX_DIMS;
+      for (size_t k = 0; k < parts.size() && ok; k++) {
+        ok = parseUnsigned(parts[k], &n) && n > 0;
+        result.chunks[k] = n;
+      }
+      result.nChunks = parts.size();
+    }
+    else if (sameText(key, "filter")) {
+      splitView(value, ':', &parts);
+      ok = parseUnsigned(parts[0], &n) && n > 0 && n <= 0xffffffffUL;
+      result.filter = n;
+      result.filterParams.clear();
+      for (size_t k = 1; k < parts.size() && ok; k++) {
+        ok = parseUnsigned(parts[k], &n) && n <= 0xffffffffUL;
+        result.filterParams.push_back(n);
+      }
+    }
+    else {
+      fprintf(stderr, "ERROR unknown storage setting %s\n", word.c_str());
+      return false;
+    }
+
+    if (!ok) {
+      fprintf(stderr, "ERROR invalid value for storage setting %s\n", word.c_str());
+      return false;
+    }
+  }
+
+  *this = result;
+  return true;
+}
+
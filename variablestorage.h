@@ -0,0 +1,39 @@
+// Copyright 2017 Fred Hutchinson Cancer Research Center
+
+
+#ifndef VARIABLESTORAGE_H
+#define VARIABLESTORAGE_H
+
+#include <stddef.h>
+#include <vector>
+
+
+#define STORAGE_MAX_DIMS 3
+
+
+//! How a variable is laid out and compressed in the HDF5 file under netCDF-4
+// Settings are read from text like "chunk=1024x64x3 deflate=4 shuffle=on
+// filter=32015:3", the keys in any order, a later one replacing.  chunk
+// lists a size per dimension in the variable's order, sizes beyond the
+// dimension are clipped and dimensions not listed are taken whole, so one
+// shape fits variables with and without an arbN dimension; without it
+// netCDF picks the chunks of compressed or filtered variables.  filter is a registered HDF5 filter id with its
+// parameters, zstd or blosc when the netCDF library was built with them.
+struct VariableStorage {
+  VariableStorage() : nChunks(0), deflate(0), shuffle(false), filter(0) { }
+
+  size_t nChunks;  //0 for the netCDF default
+  size_t chunks[STORAGE_MAX_DIMS];
+  int deflate;     //zlib level, 0 for none
+  bool shuffle;
+  unsigned int filter;  //0 for none
+  std::vector<unsigned int> filterParams;
+
+  bool compressed() const { return deflate > 0 || shuffle || 0 != filter; }
+
+  //false after an error message, the settings are then unchanged
+  bool parse(const char *settings);
+};
+
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "sspt_ascription.h"
 #include "vcf40field-translator.h"
@@ -15,11 +16,25 @@ int main(int argc, char *argv[])
   const char *alternateHeaderFile=0;
   bool sort = true;
   bool duplicates = false;
+  bool mappedInput = false;
+  bool decodeFormat = false;
+  const char *threads = 0;
+  const char *maxMemory = 0;
+  const char *snpMajor = 0;
+  const char *storage = 0;
+  const char *storageFile = 0;
 
   options.quality("i", &inputFile, true, "input file names");
   options.quality("o", &outputFile, true, "output file pathname");
   options.quality("alt", &alternateHeaderFile, false, "alternate header file (if the original vcf has errors)");
   options.quality("s", &sort, false, "<on|off> sort by chromosome,position");
+  options.quality("mmap", &mappedInput, false, "<on|off> read input through a memory mapping");
+  options.quality("decode", &decodeFormat, false, "<on|off> decode FORMAT fields while loading instead of keeping the sample strings");
+  options.quality("threads", &threads, false, "number of worker threads (default 1)");
+  options.quality("maxmem", &maxMemory, false, "megabytes for the blocks per-sample variables are written in and their decode caches (default 1024)");
+  options.quality("snpmajor", &snpMajor, false, "<genotypes|format|all> per-sample variables stored SNPs x Samples (default Samples x SNPs)");
+  options.quality("storage", &storage, false, "chunking and compression by <genotypes|format|info|all|name prefix>, e.g. \"genotypes chunk=4096x64x3 deflate=4 shuffle=on; all deflate=1\"");
+  options.quality("storagefile", &storageFile, false, "file of storage settings, one \"<class> <settings>\" per line");
   //options.quality("dup", &duplicates, false, "<on|off> allow duplicate positions when sorting");
 
   if (!options.evaluate(argc, argv)) {
@@ -44,19 +59,32 @@ int main(int argc, char *argv[])
     return -1;
   }
 #endif
- VCF40 *vcf = new VCF40;
-  if (!VCF40::loadVCF40(vcf, inputFile)) {
-    fprintf(stderr, "ERROR could not load %s\n", inputFile);
-    return -1;
+ VCF40::LoadOptions loadOptions;
+  loadOptions.mappedInput = mappedInput;
+  if (0 != threads) {
+    int n = atoi(threads);
+    if (n < 1) {
+      fprintf(stderr, "ERROR invalid number of threads %s\n", threads);
+      return -1;
+    }
+    loadOptions.threads = n;
   }
 
   VCF40 *alt = 0;
   if (0 != alternateHeaderFile) {
     alt = new VCF40;
-    if (!VCF40::loadVCF40(alt, alternateHeaderFile)) {
+    if (!VCF40::loadVCF40(alt, alternateHeaderFile, loadOptions)) {
       fprintf(stderr, "ERROR could not load %s\n", alternateHeaderFile);
       return -1;
     }
+    loadOptions.declarations = alt;  //INFO and FORMAT are decoded as the alternate header declares them
+  }
+  loadOptions.decodeFormat = decodeFormat;
+
+ VCF40 *vcf = new VCF40;
+  if (!VCF40::loadVCF40(vcf, inputFile, loadOptions)) {
+    fprintf(stderr, "ERROR could not load %s\n", inputFile);
+    return -1;
   }
 
   printf("VCF snps %zu samples %zu\n", vcf->nSNPs, vcf->nSamples);
@@ -67,6 +95,28 @@ int main(int argc, char *argv[])
 
   //VCF40Translator vt;
   VCF40FieldTranslator vt;
+  vt.threads(loadOptions.threads);
+  if (0 != maxMemory) {
+    int n = atoi(maxMemory);
+    if (n < 1) {
+      fprintf(stderr, "ERROR invalid memory size %s\n", maxMemory);
+      return -1;
+    }
+    vt.maxMemory((size_t) n << 20);
+  }
+  if (0 != snpMajor) {
+    bool genotypes = (0 == strcmp(snpMajor, "genotypes") || 0 == strcmp(snpMajor, "all"));
+    bool format = (0 == strcmp(snpMajor, "format") || 0 == strcmp(snpMajor, "all"));
+    if (!genotypes && !format) {
+      fprintf(stderr, "ERROR invalid variable class %s for snpmajor\n", snpMajor);
+      return -1;
+    }
+    vt.snpMajor(genotypes, format);
+  }
+  if (0 != storageFile && !vt.storageFile(storageFile))
+    return -1;
+  if (0 != storage && !vt.storage(storage))
+    return -1;
   if (!vt.process(outputFile, vcf, alt, sort)) {
     fprintf(stderr, "ERROR could not convert vcf info %s into netCDF\n", inputFile);
     return -1;
@@ -4,15 +4,30 @@
 #include <string.h>
 #include <math.h>
 #include <malloc.h>
+#include <sys/time.h>
+#include <pthread.h>
 
 #include "vcf40.h"
 
 #include "sspt_delimiterparse.h"
 
-#include "utilstext.h"
+#include "linereader.h"
+#include "textview.h"
+#include "delimiterscan.h"
+#include "numberparse.h"
+#include "threadpool.h"
 #include "utilsfilter.h"
 
 #define MAX_INFO_FIELD_WIDTH 128
+#define NUMBER_WIDTH 256  //chromosome names are copied out of the line to be converted
+#define PARSE_BLOCK_SIZE (16 << 20)  //bytes of data lines read per parallel parse round
+#define PARSE_RANGE_SIZE (64 << 10)  //bytes of data lines per parse task, small enough to balance threads
+#define SLICES_PER_THREAD 4  //pieces a wide line is cut into for each thread
+#define DEDUP_BLOCK_ROWS 256  //rows that share one choice of deduplicated or raw sample strings
+#define DEDUP_WINDOW_SLOTS 8  //the hit rate is followed over this many slots of
+#define DEDUP_SLOT_CELLS (1 << 16)  //looked up cells
+#define DEDUP_MIN_HIT_RATE 0.05  //below this sample strings are stored without a lookup
+#define DEDUP_PROBE_BLOCKS 16  //while stored raw, one block in this many is still looked up
 
 static bool parseKeyValue(std::string *key, std::string *value, const std::string line, bool allowEmpty=false)
 {
@@ -55,244 +70,896 @@ static int searchColumns(const char *name, const sspt_DelimiterParse &columns)
 
 
 
-bool VCF40::loadVCF40(VCF40 *vcf, const char *file)
+struct ColumnLayout {
+  int chromosomeColumn;
+  int positionColumn;
+  int snpColumn;
+  int referenceColumn;
+  int alternateColumn;
+  int qualityColumn;
+  int filterColumn;
+  int infoColumn;
+  int formatColumn;
+  int sample0Column;
+  size_t columnCount;
+
+  ColumnLayout() : chromosomeColumn(-1), positionColumn(-1), snpColumn(-1), referenceColumn(-1),
+                   alternateColumn(-1), qualityColumn(-1), filterColumn(-1), infoColumn(-1),
+                   formatColumn(-1), sample0Column(-1), columnCount(0) { }
+};
+
+
+static double wallSeconds()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+
+//per-snp storage grows a chunk at a time, since the number of rows is not known up front
+#define SNP_CHUNK 4096
+
+static void reserveSNPs(VCF40 *vcf, size_t rows)
+{
+  vcf->chromosome.resize( rows );
+  vcf->position.resize( rows );
+  vcf->snpName.resize( rows );
+  vcf->referenceAllele.resize( rows );
+  vcf->alternateAllele.resize( rows );
+  vcf->quality.resize( rows );
+  vcf->filters.resize( rows );
+  vcf->info.resize( rows );
+  vcf->format.resize( rows );
+  if (vcf->formatDecoded)
+    vcf->formats.resize( rows );
+  else if (vcf->nSamples > 0) {
+    vcf->perSampleString.resize( rows );
+    vcf->rawSamples.resize( rows );
+  }
+}
+
+
+
+// typed INFO columns for the ##INFO lines, which all come before the column header
+static void declareInfo(VCF40 *vcf, const VCF40 *declarations)
+{
+  typedef std::multimap<std::string, std::string>::const_iterator Iterator;
+  for (Iterator iter = declarations->headerPairs.find("INFO");
+       iter != declarations->headerPairs.upper_bound("INFO")
+       && iter != declarations->headerPairs.end(); ++iter) {
+    std::string label, vtype, number;
+    VCF40::parseDeclaration(&label, &vtype, &number, iter->second.c_str());
+    vcf->info.declare(label, vtype, number);
+  }
+}
+
+
+// typed FORMAT columns for the ##FORMAT lines, once the number of samples is known
+static void declareFormat(VCF40 *vcf, const VCF40 *declarations)
+{
+  typedef std::multimap<std::string, std::string>::const_iterator Iterator;
+  for (Iterator iter = declarations->headerPairs.find("FORMAT");
+       iter != declarations->headerPairs.upper_bound("FORMAT")
+       && iter != declarations->headerPairs.end(); ++iter) {
+    std::string label, vtype, number;
+    VCF40::parseDeclaration(&label, &vtype, &number, iter->second.c_str());
+    vcf->formats.declare(label, vtype, number);
+  }
+  vcf->formats.reset(vcf->nSamples);
+}
+
+
+
+static bool parseColumnHeader(VCF40 *vcf, ColumnLayout *layout, const char *line)
+{
+  sspt_DelimiterParse columns( line, '\t', false);
+
+  layout->chromosomeColumn = searchColumns("#CHROM", columns);
+  layout->positionColumn   = searchColumns("POS", columns);
+  layout->snpColumn        = searchColumns("ID", columns);
+  layout->referenceColumn  = searchColumns("REF", columns);
+  layout->alternateColumn  = searchColumns("ALT", columns);
+  layout->qualityColumn    = searchColumns("QUAL", columns);
+  layout->filterColumn     = searchColumns("FILTER", columns);
+  layout->infoColumn       = searchColumns("INFO", columns);
+  layout->formatColumn     = searchColumns("FORMAT", columns);
+  layout->sample0Column = layout->formatColumn+1;
+  layout->columnCount = columns.values();
+  if (-1 == layout->formatColumn) {
+    fprintf(stderr, "WARNING no genotype data columns\n");
+    vcf->nSamples = 0;
+  }
+  else {  // yes there is a format column which implies there is per-sample info
+    vcf->nSamples = columns.values() - layout->sample0Column;
+    vcf->sampleID.resize( vcf->nSamples );
+
+    vcf->perSampleString.reset( vcf->nSamples );
+
+    for (size_t i = 0; i < vcf->nSamples; i++) {
+      vcf->sampleID[i] = columns.value(i + layout->sample0Column);
+    }
+  }
+  return true;
+}
+
+
+
+// reusable tokenizer storage, so a data line is split without any allocation
+struct LineScratch {
+  std::vector<TextView> columns;
+  std::vector<TextView> fields;
+  std::vector<int> subfields;  //of the decoded FORMAT keys in the cached schema
+
+  //the last FORMAT column seen, which the next row most likely repeats
+  bool schemaCached;
+  std::string schemaText;
+  uint32_t schema;
+
+  LineScratch() : schemaCached(false), schema(FORMAT_NO_SCHEMA) { }
+};
+
+
+//! Chooses per block of rows whether sample strings are deduplicated or stored raw
+// Interning pays off when cells repeat, as in columns of mostly 0/0, and is
+// only overhead when nearly every cell is new, as with per-sample AD or PL
+// values. The hit rate of looked up cells is followed over a sliding window
+// of the last DEDUP_WINDOW_SLOTS * DEDUP_SLOT_CELLS of them. A block started
+// while it is below DEDUP_MIN_HIT_RATE stores its rows raw in RawSamples,
+// except every DEDUP_PROBE_BLOCKS-th block, which keeps the window current.
+// Either way a cell reads back the same, only memory and time differ, and
+// raw rows take no interner ids, so the id space only bounds unique strings.
+class InternPolicy {
+ public:
+  InternPolicy();
+  ~InternPolicy();
+
+  bool dedup(size_t snpIndex, bool concurrent);
+  void record(bool dedup, size_t cells, size_t hits, size_t bytesSaved, bool concurrent);
+
+  double hitRate() const { return (m_lookups > 0) ? (double) m_hits / m_lookups : 0; }
+  size_t rawCells() const { return m_rawCells; }
+  size_t bytesSaved() const { return m_bytesSaved; }
+
+ private:
+  pthread_mutex_t m_mutex;  //only taken when rows are parsed concurrently
+
+  size_t m_slotCells[DEDUP_WINDOW_SLOTS];
+  size_t m_slotHits[DEDUP_WINDOW_SLOTS];
+  size_t m_slot;
+  bool m_nextDedup;  //from the window, taken up by the next block
+
+  size_t m_block;
+  bool m_blockDedup;
+
+  size_t m_lookups;
+  size_t m_hits;
+  size_t m_rawCells;
+  size_t m_bytesSaved;
+};
+
+
+InternPolicy::InternPolicy()
+  : m_slot(0), m_nextDedup(true), m_block(0), m_blockDedup(true), m_lookups(0), m_hits(0), m_rawCells(0), m_bytesSaved(0)
+{
+  pthread_mutex_init(&m_mutex, 0);
+  memset(m_slotCells, 0, sizeof(m_slotCells));
+  memset(m_slotHits, 0, sizeof(m_slotHits));
+}
+
+
+InternPolicy::~InternPolicy()
+{
+  pthread_mutex_destroy(&m_mutex);
+}
+
+
+bool InternPolicy::dedup(size_t snpIndex, bool concurrent)
+{
+  size_t block = snpIndex / DEDUP_BLOCK_ROWS;
+  if (0 == block % DEDUP_PROBE_BLOCKS)
+    return true;
+
+  if (concurrent)
+    pthread_mutex_lock(&m_mutex);
+  if (block > m_block) {  //blocks parsed concurrently can arrive a little out of order, those keep the current choice
+    m_block = block;
+    m_blockDedup = m_nextDedup;
+  }
+  bool dedup = m_blockDedup;
+  if (concurrent)
+    pthread_mutex_unlock(&m_mutex);
+  return dedup;
+}
+
+
+void InternPolicy::record(bool dedup, size_t cells, size_t hits, size_t bytesSaved, bool concurrent)
+{
+  if (concurrent)
+    pthread_mutex_lock(&m_mutex);
+
+  if (!dedup)
+    m_rawCells += cells;
+  else {
+    m_lookups += cells;
+    m_hits += hits;
+    m_bytesSaved += bytesSaved;
+
+    m_slotCells[m_slot] += cells;
+    m_slotHits[m_slot] += hits;
+    if (m_slotCells[m_slot] >= DEDUP_SLOT_CELLS) {
+      size_t windowCells = 0, windowHits = 0;
+      for (size_t i = 0; i < DEDUP_WINDOW_SLOTS; i++) {
+        windowCells += m_slotCells[i];
+        windowHits += m_slotHits[i];
+      }
+      m_nextDedup = windowHits >= DEDUP_MIN_HIT_RATE * windowCells;
+
+      m_slot = (m_slot + 1) % DEDUP_WINDOW_SLOTS;
+      m_slotCells[m_slot] = 0;
+      m_slotHits[m_slot] = 0;
+    }
+  }
+
+  if (concurrent)
+    pthread_mutex_unlock(&m_mutex);
+}
+
+
+
+static void splitStrings(std::vector<std::string> *out, const TextView &text, char delimiter, LineScratch *scratch)
 {
-  FILE *fptr = fopen(file, "rb");
-  if (0 == fptr) {
-    fprintf(stderr, "ERROR cannot open %s\n", file);
+  splitView(text, delimiter, &scratch->fields);
+  out->resize( scratch->fields.size() );
+  for (size_t i = 0; i < scratch->fields.size(); i++)
+    (*out)[i].assign( scratch->fields[i].ptr, scratch->fields[i].length );
+}
+
+
+
+static bool checkColumnCount(const VCF40 *vcf, size_t snpIndex, const ColumnLayout &layout, size_t found)
+{
+  size_t expected = (-1 == layout.formatColumn) ? layout.columnCount : layout.sample0Column + vcf->nSamples;
+  if (found < expected) {
+    fprintf(stderr, "ERROR expected %zu columns, found %zu at SNP %zu\n", expected, found, snpIndex);
     return false;
   }
+  return true;
+}
+
+
+// everything in row snpIndex before FORMAT
+static void parseFixedColumns(VCF40 *vcf, size_t snpIndex, const ColumnLayout &layout, const TextView *columns, LineScratch *scratch)
+{
+  char number[NUMBER_WIDTH];
+
+  if (-1 != layout.chromosomeColumn) {
+    const char *name = columns[layout.chromosomeColumn].copy(number, NUMBER_WIDTH);
+    if ('c' == name[0])  //skip over 'chr'
+      vcf->chromosome[ snpIndex ] = ChromosomeFilter::filter( name + 3 );
+    else
+      vcf->chromosome[ snpIndex ] = ChromosomeFilter::filter( name );
+  }
 
-  size_t width=0;
-  size_t rows=0;
-  UtilsText::scanLineWidth(&width, file);
-  UtilsText::scanRowCount(&rows, file);
+  if (-1 != layout.positionColumn) {
+    parseInt( columns[layout.positionColumn], &vcf->position[ snpIndex ] );
+  }
 
-  printf("width %zu rows %zu\n", width, rows);
-  width += 256; //safety buffer
+  if (-1 != layout.snpColumn) {
+    vcf->snpName[ snpIndex ].assign( columns[layout.snpColumn].ptr, columns[layout.snpColumn].length );
+  }
+  if (-1 != layout.referenceColumn) {
+    //vcf->referenceAllele[ snpIndex ] =  AlleleFilter::filter( columns.value(referenceColumn) );
+    vcf->referenceAllele[ snpIndex ].assign( columns[layout.referenceColumn].ptr, columns[layout.referenceColumn].length );
+  }
 
-  int chromosomeColumn = -1;
-  int positionColumn = -1;
-  int snpColumn = -1;
-  int referenceColumn = -1;
-  int alternateColumn = -1;
-  int qualityColumn = -1;
-  int filterColumn = -1;
-  int infoColumn = -1;
-  int formatColumn = -1;
-  int sample0Column = -1;
+  if (-1 != layout.alternateColumn) {
+    splitStrings( &vcf->alternateAllele[ snpIndex ], columns[layout.alternateColumn], ',', scratch );
+  }
 
-  char *line = new char[width];
-  size_t lineCount = 0;
-  size_t refSNPLine = 0;
+  if (-1 != layout.qualityColumn) {
+    parseDouble( columns[layout.qualityColumn], &vcf->quality[ snpIndex ] );
+  }
 
+  if (-1 != layout.filterColumn) {
+    splitStrings( &vcf->filters[ snpIndex ], columns[layout.filterColumn], ';', scratch );
+  }
 
 
-  while (0 != fgets(line, width, fptr)) {
-    int lineLength = strlen(line);
-    lineCount++;
-    //printf("line %zu %i\n", lineCount, lineLength);
+  if (-1 != layout.infoColumn) {
+    //keys and values in one pass, a field ended by '=' is a key
+    std::vector<TextView> &fields = scratch->fields;
+    size_t n = splitViewAny(columns[layout.infoColumn], ";=", &fields);
+    for (size_t i = 0; i < n; i++) {
+      const TextView &key = fields[i];
+      TextView value;
+      //from vcf 40 spec Keys without corresponding values are allowed in order to indicate group membership 
+      //so just set to one
+      if (i + 1 == n || ';' == key.ptr[key.length]) {
+        value = TextView("1", 1);
+      }
+      else {  //the value runs to the next ';', any further '=' are part of it
+        size_t last = i + 1;
+        while (last + 1 < n && ';' != fields[last].ptr[fields[last].length])
+          last++;
+        value = TextView(fields[i+1].ptr, fields[last].ptr + fields[last].length - fields[i+1].ptr);
+        i = last;
+      }
+      //WORKAROUND large ANNO field size (greater that 2048) which causes problem in creation of netCDF
+      if (value.length > MAX_INFO_FIELD_WIDTH) {
+        if (!key.equals("ANNO"))
+          fprintf(stderr, "WARNING at SNP %zu, %s field is too big\n", snpIndex, key.str().c_str());
+        value.length = MAX_INFO_FIELD_WIDTH-1;
+      }
+      vcf->info.store(key, value, snpIndex);
+    }
+  }
+}
+
+
+// FORMAT schema of row snpIndex, and in decode mode the subfields of the
+// FORMAT columns in it, both kept in scratch for the rows that follow
+static void parseFormatColumn(VCF40 *vcf, size_t snpIndex, const ColumnLayout &layout, const TextView *columns,
+                              LineScratch *scratch, bool concurrent)
+{
+  if (-1 == layout.formatColumn)
+    return;
+
+  const TextView &text = columns[layout.formatColumn];
+  if (!scratch->schemaCached || 0 != text.compare(scratch->schemaText.data(), scratch->schemaText.size())) {
+    scratch->schema = vcf->formatSchemas.intern(text, concurrent);
+    scratch->schemaText.assign(text.ptr, text.length);
+    scratch->schemaCached = true;
+    if (vcf->formatDecoded)
+      vcf->formats.layout(text, &scratch->subfields, &scratch->fields);
+  }
+  vcf->format[ snpIndex ] = scratch->schema;
+}
 
-    if (line[ lineLength-1 ] == '\n')
-      line[ lineLength-1 ] = 0;
-    if (lineLength < 2) {
-      fprintf(stderr, "ERROR line length too small at line %zu\n", lineCount);
+
+// the sample columns of row snpIndex copied as one piece, for a row stored without lookups
+static bool storeRawSamples(VCF40 *vcf, size_t snpIndex, const TextView *samples, bool concurrent)
+{
+  if (0 == vcf->nSamples)
+    return true;
+  const TextView &last = samples[vcf->nSamples - 1];
+  return vcf->rawSamples.store(snpIndex, samples[0].ptr, last.ptr + last.length - samples[0].ptr, concurrent);
+}
+
+
+// sample columns [first, last) of row snpIndex, samples points at the column of sample 0;
+// unless dedup, the row must already be stored by storeRawSamples()
+static bool parseSamples(VCF40 *vcf, size_t snpIndex, const TextView *samples, size_t first, size_t last,
+                         bool dedup, InternPolicy *policy, bool concurrent)
+{
+  //supposedly for short strings std::string is not so good.
+  //http://jovislab.com/blog/?p=76
+
+  //try finding unique strings, should be plenty based on previous experimenting
+  //only strings not seen before are copied out of the line, unless the policy
+  //found too few repeats to be worth looking them up, then a cell is the
+  //offset of its string in the raw row
+  if (!dedup) {
+    for (size_t i = first; i < last; i++)
+      vcf->perSampleString.set(snpIndex, i, (uint32_t) (samples[i].ptr - samples[0].ptr));
+    policy->record(false, last - first, 0, 0, concurrent);
+    return true;
+  }
+
+  size_t hits = 0;
+  size_t bytesSaved = 0;
+  for (size_t i = first; i < last; i++) {
+    const TextView &cell = samples[i];
+    uint32_t id;
+    bool found = false;
+    if (!vcf->uniqueStrings.intern(cell.ptr, cell.length, &id, concurrent, &found))
       return false;
+    if (found) {
+      hits++;
+      bytesSaved += cell.length + 1;
     }
 
-    if ('#' == line[0] && '#' == line[1]) {  //parse key value pair
+    vcf->perSampleString.set(snpIndex, i, id);
+  }
+
+  policy->record(true, last - first, hits, bytesSaved, concurrent);
+  return true;
+}
+
+
+// fills row snpIndex, which must already be reserved, and nothing else except
+// for uniqueStrings and the format overflow records, so separate lines can be
+// parsed concurrently
+static bool parseDataLine(VCF40 *vcf, size_t snpIndex, const ColumnLayout &layout, const TextView &line, LineScratch *scratch,
+                          InternPolicy *policy, bool concurrent=false)
+{
+  std::vector<TextView> &columns = scratch->columns;
+  splitView(line, '\t', &columns);
+  if (!checkColumnCount(vcf, snpIndex, layout, columns.size()))
+    return false;
+
+  parseFixedColumns(vcf, snpIndex, layout, &columns[0], scratch);
+  parseFormatColumn(vcf, snpIndex, layout, &columns[0], scratch, concurrent);
+  if (vcf->formatDecoded && -1 != layout.formatColumn) {
+    vcf->formats.store(snpIndex, &columns[0] + layout.sample0Column, 0, vcf->nSamples, scratch->subfields,
+                       &scratch->fields);
+    return true;
+  }
+  const TextView *samples = &columns[0] + layout.sample0Column;
+  bool dedup = policy->dedup(snpIndex, concurrent);
+  if (!dedup && !storeRawSamples(vcf, snpIndex, samples, concurrent))
+    return false;
+  return parseSamples(vcf, snpIndex, samples, 0, vcf->nSamples, dedup, policy, concurrent);
+}
+
+
+
+// progress of a load, shared by the serial and the parallel parser
+struct LoadState {
+  ColumnLayout layout;
+  LineScratch scratch;
+  InternPolicy policy;
+  const VCF40 *declarations;  //header the INFO and FORMAT columns are declared from
+  bool foundColumnHeader;
+  size_t snpIndex;
+  size_t reserved;
+  size_t lineCount;
+
+  LoadState() : declarations(0), foundColumnHeader(false), snpIndex(0), reserved(0), lineCount(0) { }
+};
+
+
+static bool loadLine(VCF40 *vcf, LoadState *state, const char *line, size_t lineLength)
+{
+  state->lineCount++;
+
+  if (lineLength < 1) {
+    fprintf(stderr, "ERROR line length too small at line %zu\n", state->lineCount);
+    return false;
+  }
+
+  if ('#' == line[0]) {  //header lines are few, copy them so they are null terminated
+    std::string header(line, lineLength);
+
+    if (lineLength > 1 && '#' == line[1]) {  //parse key value pair
       std::string key, value;
-      if (!parseKeyValue(&key, &value, line+2))
+      if (!parseKeyValue(&key, &value, header.c_str()+2))
         return false;
       vcf->headerPairs.insert(std::pair<std::string, std::string>(key, value));
     }
-    else if ('#' == line[0] ) { //parse column header
-      vcf->nSNPs = rows - lineCount;
-      refSNPLine = lineCount+1;
-      
-
-      vcf->chromosome.resize( vcf->nSNPs );
-      vcf->position.resize( vcf->nSNPs );
-      vcf->snpName.resize( vcf->nSNPs );
-      vcf->referenceAllele.resize( vcf->nSNPs );
-      vcf->alternateAllele.resize( vcf->nSNPs );
-      vcf->quality.resize( vcf->nSNPs );
-      vcf->filters.resize( vcf->nSNPs );
-      vcf->info.resize( vcf->nSNPs );
-      vcf->format.resize( vcf->nSNPs );
-
-      sspt_DelimiterParse columns( line, '\t', false);
-
-      
-      chromosomeColumn = searchColumns("#CHROM", columns);
-      positionColumn   = searchColumns("POS", columns);
-      snpColumn        = searchColumns("ID", columns);
-      referenceColumn  = searchColumns("REF", columns);
-      alternateColumn  = searchColumns("ALT", columns);
-      qualityColumn    = searchColumns("QUAL", columns);
-      filterColumn     = searchColumns("FILTER", columns);
-      infoColumn       = searchColumns("INFO", columns);
-      formatColumn     = searchColumns("FORMAT", columns);
-      sample0Column = formatColumn+1;
-      if (-1 == formatColumn) {
-        fprintf(stderr, "WARNING no genotype data columns\n");
-        vcf->nSamples = 0;
-      }
-      else {  // yes there is a format column which implies there is per-sample info
-        vcf->nSamples = columns.values() - sample0Column;
-        vcf->sampleID.resize( vcf->nSamples );
-
-        //vcf->sampleGenotypeInfo = sspt_TMatrix< std::vector<std::string> > (vcf->nSNPs,
-        //                                                                    vcf->nSamples );
-        //vcf->perSampleString = sspt_TMatrix< std::string > (vcf->nSNPs, vcf->nSamples );
-        vcf->perSampleString = sspt_TMatrix< const char * > (vcf->nSNPs, vcf->nSamples );
-
-        for (size_t i = 0; i < vcf->nSamples; i++) {
-          vcf->sampleID[i] = columns.value(i + sample0Column);
-        }
-      }
+    else { //parse column header
+      if (!parseColumnHeader(vcf, &state->layout, header.c_str()))
+        return false;
+      declareInfo(vcf, state->declarations);
+      if (vcf->formatDecoded)
+        declareFormat(vcf, state->declarations);
+      state->foundColumnHeader = true;
+    }
+  }
+  else if (!state->foundColumnHeader) {
+    fprintf(stderr, "ERROR data before column header at line %zu\n", state->lineCount);
+    return false;
+  }
+  else {  //parse column data
+    if (state->snpIndex == state->reserved) {
+      state->reserved += SNP_CHUNK;
+      reserveSNPs(vcf, state->reserved);
+    }
+    if (!parseDataLine(vcf, state->snpIndex, state->layout, TextView(line, lineLength), &state->scratch, &state->policy))
+      return false;
+    state->snpIndex++;
+  }
+  return true;
+}
+
+
+
+enum RangePass { RANGE_COUNT, RANGE_PARSE };
 
+
+//! Newline aligned byte range of data lines, counted then parsed on a worker thread
+struct ParseRange : public WorkerTask {
+  VCF40 *vcf;
+  const ColumnLayout *layout;
+  InternPolicy *policy;
+  RangePass pass;
+  const char *begin;
+  const char *end;
+
+  size_t lines;
+  size_t firstSNP;
+  bool serialOnly;  //holds a header or an empty line, left to loadLine()
+  bool ok;
+  LineScratch scratch;
+
+  void run();
+};
+
+
+void ParseRange::run()
+{
+  ok = true;
+  if (RANGE_COUNT == pass) {
+    lines = 0;
+    serialOnly = false;
+  }
+
+  size_t snpIndex = firstSNP;
+  const char *line = begin;
+  while (line < end) {
+    const char *newline = (const char *) memchr(line, '\n', end - line);
+    size_t length = ((0 != newline) ? newline : end) - line;
+
+    if (RANGE_COUNT == pass) {
+      lines++;
+      if (0 == length || '#' == line[0])
+        serialOnly = true;
     }
-    else {  //parse column data
-      size_t snpIndex = lineCount - refSNPLine;
-      
-      sspt_DelimiterParse columns( line, '\t', false);
+    else if (!parseDataLine(vcf, snpIndex++, *layout, TextView(line, length), &scratch, policy, true)) {
+      ok = false;
+      return;
+    }
+    line += length + 1;
+  }
+}
 
 
-      if (-1 != chromosomeColumn) {
-        if ('c' == columns.value(chromosomeColumn)[0])  //skip over 'chr'
-          vcf->chromosome[ snpIndex ] = ChromosomeFilter::filter( columns.value(chromosomeColumn) + 3 );
-        else
-          vcf->chromosome[ snpIndex ] = ChromosomeFilter::filter( columns.value(chromosomeColumn) );
-      }
 
-      if (-1 != positionColumn) {
-        vcf->position[ snpIndex ] =  atoi( columns.value(positionColumn) );
-      }
+enum SlicePass { SLICE_TABS, SLICE_SAMPLES };
 
-      if (-1 != snpColumn) {
-        vcf->snpName[ snpIndex ] =  columns.value(snpColumn);
-      }
-      if (-1 != referenceColumn) {
-        //vcf->referenceAllele[ snpIndex ] =  AlleleFilter::filter( columns.value(referenceColumn) );
-        vcf->referenceAllele[ snpIndex ] =   columns.value(referenceColumn);
-      }
 
-      if (-1 != alternateColumn) {
-        sspt_DelimiterParse fields( columns.value(alternateColumn), ',', false );
-        std::vector<std::string> edits( fields.values() );
-        for (size_t i = 0; i <  fields.values(); i++)
-          edits[i] = fields.value(i);
-        vcf->alternateAllele[ snpIndex ] =  edits;
-      }
+//! Part of one wide line, its tabs are found then a range of its sample columns parsed on a worker thread
+struct LineSlice : public WorkerTask {
+  VCF40 *vcf;
+  InternPolicy *policy;
+  SlicePass pass;
 
-      if (-1 != qualityColumn) {
-        vcf->quality[ snpIndex ] =  atof( columns.value(qualityColumn) );
-      }
+  TextView bytes;  //searched for tabs
+  std::vector<TextView> pieces;  //the first and last may continue in the neighbouring slices
 
-      if (-1 != filterColumn) {
-        sspt_DelimiterParse fields( columns.value(filterColumn), ';', false);
-        std::vector<std::string> filters( fields.values() );
-        for (size_t i = 0; i <  fields.values(); i++)
-          filters[i] = fields.value(i);
-        vcf->filters[ snpIndex ] =  filters;
-      }
+  const TextView *samples;
+  const std::vector<int> *subfields;  //of the decoded FORMAT keys
+  size_t snpIndex;
+  size_t firstSample;
+  size_t lastSample;
+  bool dedup;
+  bool ok;
+  LineScratch scratch;
 
+  void run();
+};
 
-      if (-1 != infoColumn) {
-        sspt_DelimiterParse fields( columns.value(infoColumn), ';', false);
-        std::map<std::string, std::string> pairs;
-        for (size_t i = 0; i <  fields.values(); i++) {
-          std::string key, value, group=fields.value(i);
-          //from vcf 40 spec Keys without corresponding values are allowed in order to indicate group membership 
-          //so just set to one
-          if (!parseKeyValue(&key, &value, group, true))
-            return false;
-          //WORKAROUND large ANNO field size (greater that 2048) which causes problem in creation of netCDF
-          if (value.size() > MAX_INFO_FIELD_WIDTH) {
-            if (key != "ANNO")
-              fprintf(stderr, "WARNING at SNP %zu, %s field is too big\n", snpIndex, key.c_str());
-            value.resize(MAX_INFO_FIELD_WIDTH-1);
-          }
-          pairs.insert( std::pair<std::string, std::string>(key, value) );
-        }
-        vcf->info[ snpIndex ] =  pairs;
-      }
 
+void LineSlice::run()
+{
+  if (SLICE_TABS == pass) {
+    splitView(bytes, '\t', &pieces);
+    return;
+  }
+  if (vcf->formatDecoded) {
+    vcf->formats.store(snpIndex, samples, firstSample, lastSample, *subfields, &scratch.fields);
+    ok = true;
+    return;
+  }
+  ok = parseSamples(vcf, snpIndex, samples, firstSample, lastSample, dedup, policy, true);
+}
 
-      if (-1 != formatColumn) {
-        sspt_DelimiterParse fields( columns.value(formatColumn), ':', false);
-        std::vector<std::string> datatypes( fields.values() );
-        for (size_t i = 0; i <  fields.values(); i++)
-          datatypes[i] = fields.value(i);
-        vcf->format[ snpIndex ] =  datatypes;
-      }
-#if 0
-      //old way, parses only once, but the standard template library seems to be using a lot of memory, ~277 bytes per-sample, per-snp
-      for (size_t i = 0; i < vcf->nSamples; i++) {
-        sspt_DelimiterParse fields( columns.value(i + sample0Column), ':', false);
-        std::vector<std::string> datafields( fields.values() );
-        for (int k = 0; k <  fields.values(); k++)
-          datafields[k] = fields.value(k);
-        vcf->sampleGenotypeInfo(snpIndex, i) =  datafields;
-      }
-#endif
 
-      //supposedly for short strings std::string is not so good.
-      //http://jovislab.com/blog/?p=76
 
-#if 0
-      //try using strdup instead
-      for (size_t i = 0; i < vcf->nSamples; i++) {
-        //vcf->perSampleString(snpIndex, i) = columns.value(i + sample0Column);
-        vcf->perSampleString(snpIndex, i) = strdup( columns.value(i + sample0Column) );
-      }
-#endif
-
-#if 1
-      //try finding unique strings, should be plenty based on previous experimenting
-      for (size_t i = 0; i < vcf->nSamples; i++) {
-        StringWrapper key( columns.value(i + sample0Column) );
-
-        const char *unique = 0;
-        if (vcf->uniqueStrings.find(key, &unique)) {
-          //printf("dup: %s\n", unique);
-        }
-        else {
-          unique = strdup( columns.value(i + sample0Column)  );
-          StringWrapper insertKey(unique);
-
-          //printf("before insert: %s\n", unique);
-          if (!vcf->uniqueStrings.insert(insertKey, unique)) {
-            fprintf(stderr, "ERROR could not insert %s\n", unique);
-            return false;
-          }
-          //printf("after insert : %s\n", unique);
-        }
-
-        vcf->perSampleString(snpIndex, i) = unique;
-      }
-#endif
+//! Parses blocks of data lines on a thread pool
+// A block is cut into newline aligned ranges, many more than there are
+// threads, so idle threads pick up the remaining ranges when line lengths
+// are uneven.  The ranges first count their lines, which gives every range
+// the index of its first snp, then fill their rows in place.  Rows do not
+// overlap, only the unique string store is shared, so the result is the
+// same as parsing the lines in order.
+//
+// Lines with very many samples leave too few ranges to keep the threads
+// busy, those blocks are parsed a line at a time instead, with the tab
+// search and then the sample columns of each line split across threads.
+class BlockParser {
+ public:
+  BlockParser(size_t threads);
+  ~BlockParser();
+
+  bool parse(VCF40 *vcf, LoadState *state, const char *block, size_t length);
+
+ private:
+  ThreadPool m_pool;
+  std::vector<ParseRange*> m_ranges;
+  std::vector<LineSlice*> m_slices;
 
+  void runPass(RangePass pass, size_t ranges);
+  bool parseWideLine(VCF40 *vcf, LoadState *state, const char *line, size_t length);
+};
+
+
+BlockParser::BlockParser(size_t threads) : m_pool(threads)
+{
+}
+
+
+BlockParser::~BlockParser()
+{
+  m_pool.waitAll();
+  for (size_t i = 0; i < m_ranges.size(); i++)
+    delete m_ranges[i];
+  for (size_t i = 0; i < m_slices.size(); i++)
+    delete m_slices[i];
+}
+
+
+void BlockParser::runPass(RangePass pass, size_t ranges)
+{
+  for (size_t i = 0; i < ranges; i++) {
+    m_ranges[i]->pass = pass;
+    m_pool.submit(m_ranges[i]);
+  }
+  m_pool.waitAll();
+}
+
+
+bool BlockParser::parse(VCF40 *vcf, LoadState *state, const char *block, size_t length)
+{
+  const char *end = block + length;
+  size_t ranges = 0;
+  for (const char *begin = block; begin < end; ranges++) {
+    const char *stop = end;
+    if ((size_t) (end - begin) > PARSE_RANGE_SIZE) {
+      const char *newline = (const char *) memchr(begin + PARSE_RANGE_SIZE, '\n', end - (begin + PARSE_RANGE_SIZE));
+      if (0 != newline)
+        stop = newline + 1;
     }
 
+    if (ranges == m_ranges.size())
+      m_ranges.push_back(new ParseRange);
+    ParseRange *range = m_ranges[ranges];
+    range->vcf = vcf;
+    range->layout = &state->layout;
+    range->policy = &state->policy;
+    range->begin = begin;
+    range->end = stop;
+    begin = stop;
   }
-  fclose(fptr);
 
+  if (ranges < m_pool.threads()) {  //few long lines
+    for (const char *line = block; line < end; ) {
+      const char *newline = (const char *) memchr(line, '\n', end - line);
+      size_t lineLength = ((0 != newline) ? newline : end) - line;
+      bool ok = (0 == lineLength || '#' == line[0])
+        ? loadLine(vcf, state, line, lineLength)
+        : parseWideLine(vcf, state, line, lineLength);
+      if (!ok)
+        return false;
+      line += lineLength + 1;
+    }
+    return true;
+  }
 
+  runPass(RANGE_COUNT, ranges);
+
+  size_t lines = 0;
+  bool serialOnly = false;
+  for (size_t i = 0; i < ranges; i++) {
+    m_ranges[i]->firstSNP = state->snpIndex + lines;
+    lines += m_ranges[i]->lines;
+    serialOnly = serialOnly || m_ranges[i]->serialOnly;
+  }
+
+  if (serialOnly) {  //rare, header lines between data lines are handled in order
+    for (const char *line = block; line < end; ) {
+      const char *newline = (const char *) memchr(line, '\n', end - line);
+      size_t lineLength = ((0 != newline) ? newline : end) - line;
+      if (!loadLine(vcf, state, line, lineLength))
+        return false;
+      line += lineLength + 1;
+    }
+    return true;
+  }
+
+  if (state->snpIndex + lines > state->reserved) {
+    while (state->snpIndex + lines > state->reserved)
+      state->reserved += SNP_CHUNK;
+    reserveSNPs(vcf, state->reserved);
+  }
+
+  runPass(RANGE_PARSE, ranges);
+
+  for (size_t i = 0; i < ranges; i++) {
+    if (!m_ranges[i]->ok)
+      return false;
+  }
+  state->snpIndex += lines;
+  state->lineCount += lines;
+  return true;
+}
+
+
+
+// one data line, the same as loadLine() does it
+bool BlockParser::parseWideLine(VCF40 *vcf, LoadState *state, const char *line, size_t length)
+{
+  size_t slices = m_pool.threads() * SLICES_PER_THREAD;
+  while (m_slices.size() < slices)
+    m_slices.push_back(new LineSlice);
+
+  size_t step = length / slices + 1;
+  for (size_t i = 0; i < slices; i++) {
+    LineSlice *slice = m_slices[i];
+    size_t begin = (i * step < length) ? i * step : length;
+    size_t end = ((i + 1) * step < length) ? (i + 1) * step : length;
+    slice->pass = SLICE_TABS;
+    slice->bytes = TextView(line + begin, end - begin);
+    m_pool.submit(slice);
+  }
+  m_pool.waitAll();
+
+  //a column cut by a slice boundary is the last piece of one slice joined to the first of the next
+  std::vector<TextView> &columns = state->scratch.columns;
+  columns.clear();
+  for (size_t i = 0; i < slices; i++) {
+    const std::vector<TextView> &pieces = m_slices[i]->pieces;
+    size_t k = 0;
+    if (i > 0) {
+      columns.back().length += pieces[0].length;
+      k = 1;
+    }
+    columns.insert(columns.end(), pieces.begin() + k, pieces.end());
+  }
+
+  state->lineCount++;
+  size_t snpIndex = state->snpIndex;
+  if (snpIndex == state->reserved) {
+    state->reserved += SNP_CHUNK;
+    reserveSNPs(vcf, state->reserved);
+  }
+  if (!checkColumnCount(vcf, snpIndex, state->layout, columns.size()))
+    return false;
+  parseFormatColumn(vcf, snpIndex, state->layout, &columns[0], &state->scratch, false);  //the slices need its subfields
+
+  //one choice for the whole row, its raw copy made before the slices take their offsets
+  const TextView *samples = &columns[0] + state->layout.sample0Column;
+  bool dedup = vcf->formatDecoded || state->policy.dedup(snpIndex, false);
+  if (!dedup && !storeRawSamples(vcf, snpIndex, samples, false))
+    return false;
+
+  size_t nSamples = vcf->nSamples;
+  for (size_t i = 0; i < slices; i++) {
+    LineSlice *slice = m_slices[i];
+    slice->vcf = vcf;
+    slice->policy = &state->policy;
+    slice->pass = SLICE_SAMPLES;
+    slice->samples = samples;
+    slice->subfields = &state->scratch.subfields;
+    slice->snpIndex = snpIndex;
+    slice->firstSample = i * nSamples / slices;
+    slice->lastSample = (i + 1) * nSamples / slices;
+    slice->dedup = dedup;
+    m_pool.submit(slice);
+  }
+  parseFixedColumns(vcf, snpIndex, state->layout, &columns[0], &state->scratch);
+  m_pool.waitAll();
+
+  for (size_t i = 0; i < slices; i++) {
+    if (!m_slices[i]->ok)
+      return false;
+  }
+  state->snpIndex++;
+  return true;
+}
+
+
+
+// header lines one at a time, then either the data lines one at a time or,
+// given a parser, in blocks
+static bool loadLines(VCF40 *vcf, LoadState *state, LineReader *reader, BlockParser *parser)
+{
+  const char *line;
+  size_t lineLength;
+  while (reader->nextLine(&line, &lineLength)) {
+    if (!loadLine(vcf, state, line, lineLength))
+      return false;
+    if (0 != parser && state->foundColumnHeader)
+      break;
+  }
+
+  if (0 != parser) {
+    const char *block;
+    size_t blockLength;
+    while (reader->nextBlock(&block, &blockLength, PARSE_BLOCK_SIZE)) {
+      if (!parser->parse(vcf, state, block, blockLength))
+        return false;
+    }
+  }
+  return !reader->failed();
+}
+
+
+
+// single pass over the input, per-snp storage grows as data lines are read
+bool VCF40::loadVCF40(VCF40 *vcf, const char *file, const LoadOptions &options)
+{
+  double startTime = wallSeconds();
+
+  LineReader reader;
+  if (!reader.open(file, options.mappedInput, options.threads)) {
+    return false;
+  }
+
+  vcf->nSNPs = 0;
+  vcf->nSamples = 0;
+  vcf->formatDecoded = options.decodeFormat;
+
+  LoadState state;
+  state.declarations = (0 != options.declarations) ? options.declarations : vcf;
+  BlockParser *parser = 0;
+  if (options.threads > 1)
+    parser = new BlockParser(options.threads);
+  bool ok = loadLines(vcf, &state, &reader, parser);
+  delete parser;
+  if (!ok)
+    return false;
+
+  vcf->nSNPs = state.snpIndex;
+  reserveSNPs(vcf, vcf->nSNPs);
+  uint64_t cellLimit = vcf->uniqueStrings.idLimit();
+  if (vcf->rawSamples.offsetLimit() > cellLimit)
+    cellLimit = vcf->rawSamples.offsetLimit();
+  vcf->perSampleString.narrow(cellLimit);
+
+  printf("rows %zu samples %zu loaded in %.2f seconds%s\n", vcf->nSNPs, vcf->nSamples, wallSeconds() - startTime,
+         options.mappedInput ? " (mapped)" : "");
+  if (vcf->formatDecoded) {
+    printf("sample columns decoded into %zu FORMAT keys\n", vcf->formats.size());
+    return true;
+  }
+  printf("unique sample strings %zu, %zu bytes in %zu bytes of arena, %zu bit ids\n", vcf->uniqueStrings.size(),
+         vcf->uniqueStrings.bytesUsed(), vcf->uniqueStrings.bytesReserved(), 8 * vcf->perSampleString.bytesPerCell());
+  printf("%.1f%% of looked up cells found, %zu bytes saved, %zu cells stored without lookup in %zu bytes\n",
+         100 * state.policy.hitRate(), state.policy.bytesSaved(), state.policy.rawCells(), vcf->rawSamples.bytesUsed());
 
   return true;
 }
 
 
+bool VCF40::parseDeclaration(std::string *label, std::string *vtype, std::string *number, const char *item)
+{
+  sspt_DelimiterParse a(item, '<', false);
+  sspt_DelimiterParse b( a.value(a.values()-1), '>', false);
+  sspt_DelimiterParse keypair(b.value(0), ',', false);
+
+  int found = 0;
+  for (size_t i = 0; i < keypair.values(); i++) {
+    sspt_DelimiterParse p( keypair.value(i), '=', false);
+    if (p.values() != 2)
+      continue;
+    else if (0 == strcmp(p.value(0), "ID")) {
+      *label = p.value(1);
+      found++;
+    }
+    else if (0 == strcmp(p.value(0), "Number")) {
+      *number = p.value(1);
+      found++;
+    }
+    else if (0 == strcmp(p.value(0), "Type")) {
+      *vtype = p.value(1);
+      found++;
+    }
+  }
+
+  return 3==found;
+}
+
+
 std::vector<std::string> VCF40::sampleGenotypeInfo(size_t i, size_t k)
 {
   //sspt_DelimiterParse fields( perSampleString(i,k).c_str(), ':', false);
   //printf("retrieve %s\n", perSampleString(i,k));
-  sspt_DelimiterParse fields( perSampleString(i,k), ':', false);
+  std::vector<TextView> fields;
+  splitView(sampleString(i,k), ':', &fields);
 
-  std::vector<std::string> datafields( fields.values() );
-  for (int k = 0; k <  fields.values(); k++)
-    datafields[k] = fields.value(k);
+  std::vector<std::string> datafields( fields.size() );
+  for (size_t k = 0; k <  fields.size(); k++)
+    datafields[k].assign(fields[k].ptr, fields[k].length);
   return datafields;
 }
@@ -9,8 +9,12 @@
 #include <vector>
 
 #include "sspt_tmatrix.h"
-#include "sspt_avltree.h"
-#include "stringwrapper.h"
+#include "stringidmatrix.h"
+#include "stringinterner.h"
+#include "rawsamples.h"
+#include "infocolumns.h"
+#include "formatcolumns.h"
+#include "formatschemas.h"
 
 
 
@@ -30,19 +34,40 @@ struct VCF40 {
   std::vector< std::vector<std::string> > alternateAllele;  //description of edits at the place
   std::vector< double > quality;
   std::vector< std::vector<std::string> > filters;
-  std::vector< std::map<std::string, std::string> > info;
-  std::vector< std::vector<std::string> > format;  //data types for coressponding sample columns
+  InfoColumns info;  //declared numeric keys, decoded while loading
+  std::vector< uint32_t > format;  //data types for coressponding sample columns, ids into formatSchemas
+  FormatSchemas formatSchemas;
   
   //by sample
   std::vector< std::string > sampleID;
 
-  //snps x samples
+  //snps x samples, grows by chunks of snps while loading
   //sspt_TMatrix< std::string > perSampleString;  // data
-  sspt_TMatrix< const char * > perSampleString;  // data
-  sspt_AVLTree< StringWrapper, const char *> uniqueStrings; // data store, potentially too slow, O(log2(N)) lookup time
+  StringIdMatrix perSampleString;  // data, ids into uniqueStrings, or offsets into the row for raw rows
+  StringInterner uniqueStrings; // data store, one copy of each distinct sample string
+  RawSamples rawSamples;  // data store for rows whose strings repeat too little to look them up
+  FormatColumns formats;  //declared FORMAT keys, used instead of the three above when formatDecoded
+  bool formatDecoded;
 
-  static bool loadVCF40(VCF40 *data, const char *file);
+  struct LoadOptions {
+    bool mappedInput;  //read through a memory mapping instead of buffered reads
+    size_t threads;    //worker threads, used for decompression and for parsing data lines
+    const VCF40 *declarations;  //loaded header whose ##INFO and ##FORMAT lines are used instead of the file's own
+    bool decodeFormat;  //decode the sample columns into formats while loading, the strings are not kept
 
+    LoadOptions() : mappedInput(false), threads(1), declarations(0), decodeFormat(false) { }
+  };
+
+  static bool loadVCF40(VCF40 *data, const char *file, const LoadOptions &options=LoadOptions());
+
+  //ID, Type and Number of an ##INFO or ##FORMAT header value, false if one is missing
+  static bool parseDeclaration(std::string *label, std::string *vtype, std::string *number, const char *item);
+
+
+  //per-sample column k of snp i, null terminated, only when the format was not decoded
+  TextView sampleString(size_t i, size_t k) const {
+    return rawSamples.raw(i) ? rawSamples.lookup(i, perSampleString(i,k)) : uniqueStrings.lookup(perSampleString(i,k));
+  }
 
   std::vector<std::string> sampleGenotypeInfo(size_t i, size_t k);
 
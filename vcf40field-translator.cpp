@@ -6,6 +6,7 @@
 #include <errno.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 
 #include "sspt_cord.h"
@@ -21,6 +22,8 @@
 #include "utilstext.h"
 
 #include "datasetdescription.h"
+#include "threadpool.h"
+#include "samplepass.h"
 
 #include "vcf_names.h"
 
@@ -63,39 +66,17 @@ VCF40FieldTranslator::VCF40FieldTranslator() : m_variableTable(TABLE_DEFAULT)
 
   m_buffer = 0;
   m_autofilter = false;
+  m_threads = 1;
+  m_maxMemory = (size_t) DEFAULT_MAX_MEMORY_MB << 20;
+  m_snpMajorGenotypes = false;
+  m_snpMajorFormat = false;
 }
 
 
 // input looks like:   <ID=PV4,Number=4,Type=Float,Descri ... >
 bool VCF40FieldTranslator::extractVariableInfo(std::string *label, std::string *vtype, std::string *number, const char *item)
 {
-  sspt_DelimiterParse a(item, '<', false);
-  sspt_DelimiterParse b( a.value(a.values()-1), '>', false);
-  sspt_DelimiterParse keypair(b.value(0), ',', false);
-
-  //printf("%s\n", b.value(0));
-
-  int found = 0;
-  for (size_t i = 0; i < keypair.values(); i++) {
-    sspt_DelimiterParse p( keypair.value(i), '=', false);
-    //printf("%s\n", keypair.value(i));
-    if (p.values() != 2)
-      continue;
-    else if (0 == strcmp(p.value(0), "ID")) {
-      *label = p.value(1);
-      found++;
-    }
-    else if (0 == strcmp(p.value(0), "Number")) {
-      *number = p.value(1);
-      found++;
-    }
-    else if (0 == strcmp(p.value(0), "Type")) {
-      *vtype = p.value(1);
-      found++;
-    }
-  }
-
-  return 3==found;
+  return VCF40::parseDeclaration(label, vtype, number, item);
 }
 
 
@@ -284,16 +265,19 @@ bool VCF40FieldTranslator::addFormatVar(const std::string &label, const std::str
   if (vtype == "Integer") {
     vcftype = VCFVariable::VCF_INT;
     var = new VCFVariableColumnFormat(label.c_str(), vcftype, n );
+    var->snpMajor(m_snpMajorFormat);
   }
   else if (vtype == "Float") {
     vcftype = VCFVariable::VCF_DOUBLE;
     var = new VCFVariableColumnFormat(label.c_str(), vcftype, n );
+    var->snpMajor(m_snpMajorFormat);
   }
   else if (vtype == "String" && label == "GT") {
     //vcftype = VCFVariable::VCF_AB;
     //n = 2;
     //var = new VCFVariableColumnFormat(label.c_str(), vcftype, n, '/');
     var = new VCFVariableGenotype(label.c_str());
+    var->snpMajor(m_snpMajorGenotypes);
   }
   else
     return false;
@@ -356,7 +340,11 @@ bool VCF40FieldTranslator::process(const char *outputFile,
   }
 
 
+  size_t written = reportWrites();
   nc_close(m_ncid);
+  struct stat info;
+  if (0 == stat(outputFile, &info))
+    printf("output %.1f MB on disk for %.1f MB of values\n", info.st_size / 1048576.0, written / 1048576.0);
   printf("finished files\n");
 
   //additional phases happen with other programs, transpose, merge, rs-write, genotype-write, ?position mapping
@@ -368,6 +356,106 @@ bool VCF40FieldTranslator::process(const char *outputFile,
 
 
 
+// "<class> <settings>", blank or comment entries are skipped
+bool VCF40FieldTranslator::storageEntry(const char *entry)
+{
+  while (isspace(*entry))
+    entry++;
+  if (0 == *entry || '#' == *entry)
+    return true;
+
+  const char *end = entry;
+  while (0 != *end && !isspace(*end))
+    end++;
+  std::string name(entry, end - entry);
+
+  StorageClass rule;
+  rule.prefix = name;
+  if ("genotypes" == name) {  //only GT, not keys like GTQ
+    rule.prefix = "array_GT";
+    rule.exact = true;
+  }
+  else if ("format" == name) {  //GT has its own class, as for -snpmajor
+    rule.prefix = "array_";
+    rule.exclude = "array_GT";
+  }
+  else if ("info" == name)
+    rule.prefix = "info_";
+  else if ("all" == name)
+    rule.prefix = "";
+
+  if (!rule.storage.parse(end)) {
+    fprintf(stderr, "ERROR invalid storage settings for %s\n", name.c_str());
+    return false;
+  }
+  m_storage.push_back(rule);
+  return true;
+}
+
+
+bool VCF40FieldTranslator::storage(const char *spec)
+{
+  std::string entries(spec);
+  size_t begin = 0;
+  while (begin <= entries.size()) {
+    size_t end = entries.find(';', begin);
+    if (std::string::npos == end)
+      end = entries.size();
+    if (!storageEntry(entries.substr(begin, end - begin).c_str()))
+      return false;
+    begin = end + 1;
+  }
+  return true;
+}
+
+
+bool VCF40FieldTranslator::storageFile(const char *file)
+{
+  FILE *fptr = fopen(file, "rb");
+  if (0 == fptr) {
+    fprintf(stderr, "ERROR Could not open %s\n", file);
+    return false;
+  }
+
+  //getline grows the buffer, so a long entry is not split into two
+  char *line = 0;
+  size_t size = 0;
+  bool ok = true;
+  while (ok && -1 != getline(&line, &size, fptr))
+    ok = storageEntry(line);
+  free(line);
+  fclose(fptr);
+  return ok;
+}
+
+
+
+// bytes written and time spent writing them per variable, the total bytes
+size_t VCF40FieldTranslator::reportWrites()
+{
+  int nVars = 0;
+  if (NC_NOERR != nc_inq_nvars(m_ncid, &nVars))
+    return 0;
+
+  size_t total = 0;
+  for (int varid = 0; varid < nVars; varid++) {
+    char name[NC_MAX_NAME+1];
+    if (NC_NOERR != nc_inq_varname(m_ncid, varid, name))
+      continue;
+    size_t bytes;
+    double seconds;
+    UtilsNetcdf::writeStats(varid, &bytes, &seconds);
+    if (0 == bytes)  //placeholders
+      continue;
+    total += bytes;
+    double mb = bytes / 1048576.0;
+    printf("wrote %s %.1f MB in %.2f seconds (%.1f MB/s)\n", name, mb, seconds, (seconds > 0) ? mb / seconds : 0.0);
+  }
+  return total;
+}
+
+
+
 bool VCF40FieldTranslator::createDescription(DataSetDescription **output, VCF40 *vcf)
 {
   
@@ -386,6 +474,14 @@ bool VCF40FieldTranslator::createDescription(DataSetDescription **output, VCF40
   if (!desc->addDimension(VCF_STRING_DIM, MAX_STRING))
     return false;
 
+  for (size_t i = 0; i < m_storage.size(); i++)
+    desc->storage(m_storage[i].prefix.c_str(), m_storage[i].storage,
+                  m_storage[i].exact, m_storage[i].exclude.c_str());
+
+  //readers check the dimension names, these say it up front
+  desc->addAttribute(GENOTYPE_LAYOUT, m_snpMajorGenotypes ? SNP_MAJOR_LAYOUT : SAMPLE_MAJOR_LAYOUT);
+  desc->addAttribute(FORMAT_LAYOUT, m_snpMajorFormat ? SNP_MAJOR_LAYOUT : SAMPLE_MAJOR_LAYOUT);
+
 
 
   //create other 2D arrays
@@ -523,19 +619,61 @@ bool VCF40FieldTranslator::processVCF(VCF40 *vcf, bool sortSNPs)
   sspt_List<VCFVariable*> list;
   m_variableTable.contents(&list);
 
+  ThreadPool *pool = 0;
+  if (m_threads > 1)
+    pool = new ThreadPool(m_threads);
+
+  BlockBuffers buffers;
+  for (sspt_ListIterator<VCFVariable*> iter = list.begin(); !iter.atEnd(); iter.moveNext())
+    iter.current()->blocks(&buffers, m_maxMemory);
+
+  //the per-sample variables are decoded together, in one pass over the sample
+  //strings on threads of its own, while this thread writes the other
+  //variables and then the decoded blocks; netCDF is only called from here
+  std::vector<VCFVariable*> order;
+  std::vector<VCFVariable*> sampled;
+  SamplePass pass(vcf);
   for (sspt_ListIterator<VCFVariable*> iter = list.begin(); !iter.atEnd(); iter.moveNext()) {
     VCFVariable *v = iter.current();
+    if (!vcf->formatDecoded && v->joinSamplePass(&pass, vcf, m_ncid))
+      sampled.push_back(v);
+    else
+      order.push_back(v);
+  }
+
+  bool result = true;
+  if (pass.size() > 0) {
+    printf("decoding %zu per-sample variables in one pass ...\n", pass.size());
+    result = pass.start(pool, m_maxMemory);
+  }
+
+  for (size_t i = 0; i < order.size() && result; i++) {
+    VCFVariable *v = order[i];
     sspt_Cord name;
     v->variableName(&name);
 
     printf("processing %s ...\n", name.c_str());
 
-    if ( !v->populateNetCDF(m_ncid, vcf) )
-      return false;
+    v->workers(pool);
+    result = v->populateNetCDF(m_ncid, vcf);
+    v->workers(0);
   }
 
+  if (result && pass.size() > 0)
+    result = pass.write();
 
-  return true;
+  for (size_t i = 0; i < sampled.size() && result; i++) {
+    sspt_Cord name;
+    sampled[i]->variableName(&name);
+
+    printf("processing %s ...\n", name.c_str());
+    result = sampled[i]->populateNetCDF(m_ncid, vcf);
+  }
+
+  for (sspt_ListIterator<VCFVariable*> iter = list.begin(); !iter.atEnd(); iter.moveNext())
+    iter.current()->blocks(0, m_maxMemory);
+  delete pool;
+  return result;
 
 }
 
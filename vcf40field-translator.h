@@ -19,6 +19,20 @@
 #include "netcdf.h"
 
 #include "vcfvariable.h"
+#include "variablestorage.h"
+
+#include <string>
+#include <vector>
+
+
+//one -storage entry, the variables it applies to by name prefix
+struct StorageClass {
+  StorageClass() : exact(false) { }
+  std::string prefix;
+  bool exact;  //the whole name, not a prefix
+  std::string exclude;  //variable name, "" for none
+  VariableStorage storage;
+};
 
 
 class VCF40FieldTranslator {
@@ -34,6 +48,17 @@ class VCF40FieldTranslator {
   
 
   void autofilter(bool flag) { m_autofilter = flag; }
+  void threads(size_t n) { m_threads = n; }  //per-sample fields are decoded on this many threads
+  void maxMemory(size_t bytes) { m_maxMemory = bytes; }  //for the blocks per-sample variables are written in
+  //SNPs x Samples rather than Samples x SNPs for the GT variable and the other FORMAT variables
+  void snpMajor(bool genotypes, bool format) { m_snpMajorGenotypes = genotypes; m_snpMajorFormat = format; }
+
+  //chunking and compression, entries "<class> <settings>" separated by ';', the
+  //class one of genotypes, format, info, all or a variable name (prefix), the
+  //settings as VariableStorage reads them; false after an error message.
+  //format is the FORMAT variables other than GT, as for snpMajor
+  bool storage(const char *spec);
+  bool storageFile(const char *file);  //one entry per line, '#' starts a comment
 
  private:
 
@@ -49,6 +74,11 @@ class VCF40FieldTranslator {
   unsigned long m_bufferSize;
 
   bool m_autofilter;  //if true, expand filter column to boolean vectors
+  size_t m_threads;
+  size_t m_maxMemory;
+  bool m_snpMajorGenotypes;
+  bool m_snpMajorFormat;
+  std::vector<StorageClass> m_storage;
   //bool m_allowDuplicates;
 
   bool extractVariableInfo(std::string *label, std::string *vtype, std::string *number, const char *item);
@@ -66,6 +96,8 @@ class VCF40FieldTranslator {
   bool sortByChromosome( sspt_Array<int> *mapping );
   bool parseGenotype(std::string *first, std::string *second, const std::string line);
   bool processVCF(VCF40 *vcf, bool sortSNPs);
+  bool storageEntry(const char *entry);
+  size_t reportWrites();
 
 
   //  bool processR2(const char *file);
@@ -53,4 +53,11 @@
 #define SNP_NAME "SNP_Name"
 #define SAMPLE_ID "Sample_ID"
 
+
+//global attributes giving the dimension order of the per-sample variables
+#define GENOTYPE_LAYOUT "genotype_layout"
+#define FORMAT_LAYOUT   "format_layout"
+#define SAMPLE_MAJOR_LAYOUT "Samples,SNPs"
+#define SNP_MAJOR_LAYOUT    "SNPs,Samples"
+
 #endif
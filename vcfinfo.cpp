@@ -45,7 +45,7 @@ int main(int argc, char *argv[])
 
   if (genotypeFlag) {
     for (size_t i = 0; i < vcf->nSNPs; i++) {
-      std::vector<std::string> format = vcf->format[i];  //data types for coressponding sample columns
+      const std::vector<std::string> &format = vcf->formatSchemas.keys(vcf->format[i]);  //data types for coressponding sample columns
 
       int index = -1;
       for (size_t j = 0; j < format.size(); j++) {
@@ -14,6 +14,10 @@
 #include "vcf40.h"
 
 #include "stringtranslator.h"
+#include "delimiterscan.h"
+#include "genotypecodes.h"
+#include "samplepass.h"
+#include "transpose.h"
 
 
 
@@ -62,76 +66,259 @@ static nc_type mapVCFType(enum VCFVariable::VCFType vcftype)
 }
 
 
-static inline bool getColumnField(std::string *out, VCF40 *vcf, size_t index, const char *field)
+// writes an INFO column decoded while loading, all 0 for a key the vcf did not declare
+template <typename T>
+bool storeColumn(int ncid,  VCF40 *vcf, size_t factor, const char *varname, const std::vector<T> *values)
 {
-  std::map<std::string, std::string> info = vcf->info[index];
-  *out = info[ field ];
+  int nret;
+  int varid;
+  size_t N = vcf->nSNPs * factor;
+
+  nret = nc_inq_varid(ncid, varname, &varid);
+  FALSE_ON_NETCDF_ERROR(nret, "ERROR could not find variable %s\n", varname);
+
+  std::vector<T> zeros;
+  if (0 == values) {
+    zeros.assign(N, 0);
+    values = &zeros;
+  }
+  if (values->size() != N) {
+    fprintf(stderr, "ERROR %s holds %zu values, expected %zu\n", varname, values->size(), N);
+    return false;
+  }
+
+  nret = put_var(ncid, varid, (0 == N) ? (const T *) 0 : &(*values)[0]);
+  FALSE_ON_NETCDF_ERROR(nret, "ERROR could not write %s\n", varname );
+
   return true;
 }
 
 
 
+
+
+// a block of snps of every sample into a samples x snps [x factor] variable,
+// snps x samples [x factor] if snpMajor
 template <typename T>
-bool storeColumn(int ncid,  VCF40 *vcf, size_t factor, const char *varname, const char *field, StringTranslator<T> *translator)
+static bool storeBlock(int ncid, int varid, const char *varname, size_t nSamples, size_t firstSNP, size_t nSNPs, size_t factor,
+                       bool snpMajor, const T *block)
 {
-  int nret;
-  int varid;
-  size_t N = vcf->nSNPs * factor;
+  size_t start[3] = { 0, firstSNP, 0 };
+  size_t count[3] = { nSamples, nSNPs, factor };  //netcdf only reads as many as the variable has dimensions
+  if (snpMajor) {
+    start[0] = firstSNP;
+    start[1] = 0;
+    count[0] = nSNPs;
+    count[1] = nSamples;
+  }
+  int nret = put_vara(ncid, varid, start, count, block);
+  FALSE_ON_NETCDF_ERROR(nret, "ERROR could not write %s\n", varname );
+  return true;
+}
 
-  // will know that it uses integer filter ...
-  //build integer filter for specific m_vcftype ?
 
 
-  nret = nc_inq_varid(ncid, varname, &varid);
-  FALSE_ON_NETCDF_ERROR(nret, "ERROR could not find variable %s\n", varname);
+//! A FORMAT variable decoded in the SamplePass
+// The decoder owns its translator, which keeps no state of its own either.
+template <typename T>
+class FormatDecoder : public SampleDecoder {
+ public:
+  FormatDecoder(StringTranslator<T> *translator, size_t factor, int ncid, int varid, const char *varname)
+    : SampleDecoder(factor * sizeof(T)), m_translator(translator), m_factor(factor),
+      m_ncid(ncid), m_varid(varid), m_varname(varname) { }
+  ~FormatDecoder() { delete m_translator; }
+
+  bool decode(const std::vector<TextView> &fields, int subfield, size_t snp, unsigned char *cell,
+              std::vector<TextView> *scratch, bool *isShort);
+
+  bool store(const unsigned char *cells, size_t firstSNP, size_t nSNPs, size_t nSamples) {
+    return storeBlock(m_ncid, m_varid, m_varname, nSamples, firstSNP, nSNPs, m_factor, snpMajor, (const T *) cells);
+  }
 
+ private:
+  StringTranslator<T> *m_translator;
+  size_t m_factor;
+  int m_ncid;
+  int m_varid;
+  const char *m_varname;
+};
 
 
-  T *buffer = new T[N];
-  for (size_t i = 0; i < vcf->nSNPs; i++) {
-    std::string s;
-    if (!getColumnField(&s, vcf, i, field) ) {
-      fprintf(stderr, "ERROR could not find %s at snp index %zu\n", varname, i);
-      return false;
+template <typename T>
+bool FormatDecoder<T>::decode(const std::vector<TextView> &fields, int subfield, size_t snp,
+                              unsigned char *cell, std::vector<TextView> *scratch, bool *)
+{
+  const size_t factor = m_factor;
+  T *out = (T *) cell;
+
+  //check for special case empty data, v3.3 apparently used empty string...
+  if (subfield == -1 ||
+      (1 == fields.size() && (fields[0].equals("./.") || 0 == fields[0].length)) ) {
+    for (size_t m = 0; m < factor; m++) {
+      out[m] = -1;
     }
+    return true;
+  }
 
-    if (factor > 1) { //parse ...
-      sspt_DelimiterParse p(s.c_str(), ',', false);
-      size_t found = p.values();
-      if (found > factor) {
-        fprintf(stderr, "ERROR expected %zu values, found %zu at snp index %zu\n", factor, p.values(), i);
-        return false;
-      }
-      for (size_t k = 0; k < factor; k++) {
-        if (k < found)
-          buffer[factor*i+k] = translator->translate( p.value(k) );
-        else
-          buffer[factor*i+k] = translator->translate( "" );
-      }
+  //trailing fields may be dropped, as when loading with -decode on
+  TextView entry = ((size_t) subfield < fields.size()) ? fields[subfield] : TextView("", 0);
+
+  if (factor > 1) { //parse ...
+    size_t found = splitView(entry, ',', scratch);
+    if (found > factor) {
+      fprintf(stderr, "ERROR (in %s) expected %zu values, found %zu at snp index %zu\n", "storeMatrix",factor, found, snp);
+      return false;
     }
-    else {
-      buffer[i] = translator->translate(s.c_str());
+    for (size_t m = 0; m < factor; m++) {
+      if (m < found)
+        out[m] = m_translator->translate( (*scratch)[m] );
+      else
+        out[m] = m_translator->translate( TextView("", 0) );
     }
   }
-  //end for loop
+  else {
+    out[0] = m_translator->translate( entry );
+  }
+  return true;
+}
 
-  nret = put_var(ncid, varid, buffer);
-  delete buffer;
-  FALSE_ON_NETCDF_ERROR(nret, "ERROR could not write %s\n", varname );
 
-  return true;
+
+//! Samples [first, last) of a FORMAT column decoded while loading, transposed for a block of snps
+// The column is snps x (samples * factor), the buffer samples x nSNPs x factor.
+// FACTOR is the number of values per sample for the common counts, 0 for any
+// other, which keeps the innermost copy of a tile a fixed length.
+template <typename T, int FACTOR>
+struct TransposeRange : public WorkerTask {
+  const ChunkedMatrix<T> *values;
+  size_t firstSNP;
+  size_t nSNPs;
+  size_t factor;  //when FACTOR is 0
+  T *buffer;
+  size_t first;
+  size_t last;
+  bool ok;
+
+  void run();
+};
+
+
+template <typename T, int FACTOR>
+void TransposeRange<T, FACTOR>::run()
+{
+  ok = true;
+  transposeTiled<T, FACTOR>(*values, firstSNP, nSNPs, first, last, factor, buffer);
+}
+
+
+static const ChunkedMatrix<int> *decodedValues(const FormatColumns::Column *column, const int *)
+{
+  return (FormatColumns::FORMAT_INT == column->kind) ? &column->ints : 0;
+}
+
+static const ChunkedMatrix<double> *decodedValues(const FormatColumns::Column *column, const double *)
+{
+  return (FormatColumns::FORMAT_DOUBLE == column->kind) ? &column->doubles : 0;
+}
+
+static const ChunkedMatrix<signed char> *decodedValues(const FormatColumns::Column *column, const signed char *)
+{
+  return (FormatColumns::FORMAT_GT == column->kind) ? &column->genotypes : 0;
+}
+
+
+// values of field as decoded while loading, 0 after an error message if they do not fit the variable
+template <typename T>
+static const ChunkedMatrix<T> *decodedColumn(VCF40 *vcf, const char *varname, const char *field, size_t factor)
+{
+  const FormatColumns::Column *column = vcf->formats.find(field);
+  if (0 == column) {
+    fprintf(stderr, "ERROR %s was not decoded while loading\n", varname);
+    return 0;
+  }
+  const ChunkedMatrix<T> *values = decodedValues(column, (const T *) 0);
+  if (0 == values || column->factor != factor) {
+    fprintf(stderr, "ERROR %s was loaded with a different declaration\n", varname);
+    return 0;
+  }
+  if (FORMAT_NO_OVERFLOW != column->overflowSNP) {
+    fprintf(stderr, "ERROR (in %s) expected %zu values, found %zu at snp index %zu\n", "storeMatrix", factor,
+            column->overflowValues, column->overflowSNP);
+    return 0;
+  }
+  return values;
 }
 
 
+template <typename T, int FACTOR>
+static bool transposeRanges(ThreadPool *pool, const ChunkedMatrix<T> *values, size_t firstSNP, size_t nSNPs, size_t nSamples,
+                            size_t factor, T *buffer)
+{
+  TransposeRange<T, FACTOR> range;
+  range.values = values;
+  range.firstSNP = firstSNP;
+  range.nSNPs = nSNPs;
+  range.factor = factor;
+  range.buffer = buffer;
+
+  std::vector< TransposeRange<T, FACTOR> > ranges;
+  return decodeSampleRanges(pool, range, nSamples, &ranges);
+}
+
 
+template <typename T>
+static bool transposeDecoded(ThreadPool *pool, const ChunkedMatrix<T> *values, size_t firstSNP, size_t nSNPs, size_t nSamples,
+                             size_t factor, T *buffer)
+{
+  switch (factor) {
+  case 1:
+    return transposeRanges<T, 1>(pool, values, firstSNP, nSNPs, nSamples, factor, buffer);
+  case 2:
+    return transposeRanges<T, 2>(pool, values, firstSNP, nSNPs, nSamples, factor, buffer);
+  case 3:
+    return transposeRanges<T, 3>(pool, values, firstSNP, nSNPs, nSamples, factor, buffer);
+  default:
+    return transposeRanges<T, 0>(pool, values, firstSNP, nSNPs, nSamples, factor, buffer);
+  }
+}
 
 
+// writes a column decoded while loading a block of snps at a time within maxBytes, transposed
+// unless the variable is snpMajor like the column
 template <typename T>
-bool storeMatrix(int ncid,  VCF40 *vcf, size_t factor, const char *varname, const char *field, StringTranslator<T> *translator)
+static bool storeDecoded(int ncid, int varid, const char *varname, const ChunkedMatrix<T> *values, VCF40 *vcf, size_t factor,
+                         bool snpMajor, ThreadPool *pool, BlockBuffers *buffers, size_t maxBytes)
+{
+  size_t nSamples = vcf->nSamples;
+  size_t block = blockSNPs(maxBytes, nSamples * factor * sizeof(T), vcf->nSNPs);
+  T *buffer = (T *) buffers->acquire(nSamples * block * factor * sizeof(T));
+
+  bool ok = true;
+  for (size_t first = 0; first < vcf->nSNPs && ok; first += block) {
+    size_t n = (first + block < vcf->nSNPs) ? block : vcf->nSNPs - first;
+    if (snpMajor) {
+      for (size_t i = 0; i < n; i++)
+        memcpy(buffer + i * nSamples * factor, values->row(first + i), nSamples * factor * sizeof(T));
+      ok = storeBlock(ncid, varid, varname, nSamples, first, n, factor, snpMajor, buffer);
+    }
+    else
+      ok = transposeDecoded(pool, values, first, n, nSamples, factor, buffer)
+        && storeBlock(ncid, varid, varname, nSamples, first, n, factor, snpMajor, buffer);
+  }
+
+  buffers->release((unsigned char *) buffer);
+  return ok;
+}
+
+
+
+// writes a FORMAT variable decoded while loading; otherwise the SamplePass has written it
+template <typename T>
+bool storeMatrix(int ncid,  VCF40 *vcf, size_t factor, const char *varname, const char *field, bool snpMajor,
+                 ThreadPool *pool, BlockBuffers *buffers, size_t maxBytes)
 {
   int nret;
   int varid;
-  size_t N = vcf->nSamples * vcf->nSNPs * factor;
 
   // will know that it uses integer filter ...
   //build integer filter for specific m_vcftype ?
@@ -141,70 +328,21 @@ bool storeMatrix(int ncid,  VCF40 *vcf, size_t factor, const char *varname, cons
   FALSE_ON_NETCDF_ERROR(nret, "ERROR could not find variable %s\n", varname);
 
 
-
-  T *buffer = new T[N];
+  std::vector<int> offsets;
+  vcf->formatSchemas.subfields(field, &offsets);
   for (size_t i = 0; i < vcf->nSNPs; i++) {
-    std::vector<std::string> formatIDs = vcf->format[i];
-
-    //sspt_DelimiterParse formatParse(formatIDs.c_str(), ':', false);
-    int subfield = -1;
-    for (size_t j = 0; j < formatIDs.size() && subfield < 0; j++) {
-      //printf("-%s\n", formatIDs[j].c_str());
-      if (formatIDs[j] == field)  {
-        subfield = j;
-      }
-    }
-    if (subfield == -1) {
+    if (-1 == offsets[ vcf->format[i] ]) {
       fprintf(stderr, "WARNING could not find field %s in format at snp index %zu\n", field, i);
-      //return true;
-      for (size_t k = 0; k < vcf->nSamples; k++) {
-        for (size_t m = 0; m < factor; m++) {
-          buffer[ k*(vcf->nSNPs * factor) + i*factor + m] = -1;
-        }
-      }
-      continue;
     }
+  }
 
-    for (size_t k = 0; k < vcf->nSamples; k++) {
-      std::vector<std::string> fields = vcf->sampleGenotypeInfo(i, k);
-
-      //check for special case empty data, v3.3 apparently used empty string...
-      if (1 == fields.size() && 
-          (fields[0] == "./." || fields[0] == "") ) {
-        for (size_t m = 0; m < factor; m++) {
-          buffer[ k*(vcf->nSNPs * factor) + i*factor + m] = -1;
-        }
-        continue;
-      }
-      
-
-
-      std::string entry = fields[subfield];
-
-      if (factor > 1) { //parse ...
-        sspt_DelimiterParse p(entry.c_str(), ',', false);
-        size_t found = p.values();
-        if (p.values() > factor) {
-          fprintf(stderr, "ERROR (in %s) expected %zu values, found %zu at snp index %zu\n", __FUNCTION__,factor, p.values(), i);
-          return false;
-        }
-        for (size_t m = 0; m < factor; m++) {
-          if (m < found)
-            buffer[ k*(vcf->nSNPs * factor) + i*factor + m] = translator->translate( p.value(m) );
-          else
-            buffer[ k*(vcf->nSNPs * factor) + i*factor + m] = translator->translate( "" );
-        }
-      }
-      else {
-        buffer[ k*(vcf->nSNPs * factor) + i*factor  ] = translator->translate( entry.c_str() );
-      }
-
-    }     //end sample loop
-  } // end snp loop
 
-  nret = put_var(ncid, varid, buffer);
-  delete buffer;
-  FALSE_ON_NETCDF_ERROR(nret, "ERROR could not write %s\n", varname );
+  if (vcf->formatDecoded) {
+    const ChunkedMatrix<T> *values = decodedColumn<T>(vcf, varname, field, factor);
+    if (0 == values)
+      return false;
+    return storeDecoded(ncid, varid, varname, values, vcf, factor, snpMajor, pool, buffers, maxBytes);
+  }
 
   return true;
 }
@@ -251,25 +389,24 @@ bool VCFVariableColumnInfo::updateDescription( DataSetDescription *desc )
 bool VCFVariableColumnInfo::populateNetCDF(int ncid,  VCF40 *vcf)
 {
   nc_type xtype = mapVCFType(m_vcftype);
+  if (NC_INT != xtype && NC_DOUBLE != xtype)
+    return false;
 
-  switch (xtype) {
-  case NC_INT: {
-    PlainTranslator<int> translator;
-    return storeColumn(ncid, vcf, m_factor, m_varname.c_str(), m_field.c_str(), &translator);
-  }
-    break;
-
-  case NC_DOUBLE: {
-    PlainTranslator<double> translator;
-    return storeColumn(ncid, vcf, m_factor, m_varname.c_str(), m_field.c_str(), &translator);
+  const InfoColumns::Column *column = vcf->info.find(m_field.c_str());
+  if (0 != column) {
+    if (column->factor != m_factor || column->isFloat != (NC_DOUBLE == xtype)) {
+      fprintf(stderr, "ERROR %s was loaded with a different declaration\n", m_varname.c_str());
+      return false;
+    }
+    if (INFO_NO_OVERFLOW != column->overflowSNP) {
+      fprintf(stderr, "ERROR expected %zu values, found %zu at snp index %zu\n", m_factor, column->overflowValues, column->overflowSNP);
+      return false;
+    }
   }
-    break;
 
-  default:
-    return false;
-  };
-
-  return true;
+  if (NC_INT == xtype)
+    return storeColumn(ncid, vcf, m_factor, m_varname.c_str(), (0 != column) ? &column->ints : 0);
+  return storeColumn(ncid, vcf, m_factor, m_varname.c_str(), (0 != column) ? &column->doubles : 0);
 }
 
 
@@ -278,6 +415,7 @@ bool VCFVariableColumnInfo::populateNetCDF(int ncid,  VCF40 *vcf)
 
 
 VCFVariableColumnFormat::VCFVariableColumnFormat(const char *label,  enum VCFType vcftype, int number)
+  : m_decoder(0)
 {
   m_varname = "array_";
   m_varname.append(label);
@@ -298,47 +436,87 @@ VCFVariableColumnFormat::VCFVariableColumnFormat(const char *label,  enum VCFTyp
 
 bool VCFVariableColumnFormat::updateDescription( DataSetDescription *desc )
 {
+  const char *row = m_snpMajor ? VCF_SNP_DIM : VCF_SAMPLE_DIM;
+  const char *col = m_snpMajor ? VCF_SAMPLE_DIM : VCF_SNP_DIM;
   if (m_number == 0 || m_number == 1) {
-    return desc->addVariable(m_varname.c_str(), mapVCFType(m_vcftype), VCF_SAMPLE_DIM, VCF_SNP_DIM);
+    return desc->addVariable(m_varname.c_str(), mapVCFType(m_vcftype), row, col);
   }
   else if (m_number > 1) {
     char dim2[128];
     snprintf(dim2, 128, "arb%i", m_number);
     desc->addDimension(dim2, m_number);
-    return desc->addVariable(m_varname.c_str(), mapVCFType(m_vcftype), VCF_SAMPLE_DIM, VCF_SNP_DIM, dim2);
+    return desc->addVariable(m_varname.c_str(), mapVCFType(m_vcftype), row, col, dim2);
   }
   return false;
 }
 
 
-bool VCFVariableColumnFormat::populateNetCDF(int ncid,  VCF40 *vcf)
+VCFVariableColumnFormat::~VCFVariableColumnFormat()
 {
-  nc_type xtype = mapVCFType(m_vcftype);
+  delete m_decoder;
+}
 
-  switch (xtype) {
-  case NC_INT: {
-    PlainTranslator<int> translator;
-    return storeMatrix(ncid, vcf, m_factor, m_varname.c_str(), m_field.c_str(), &translator);
-  }
+
+bool VCFVariableColumnFormat::joinSamplePass(SamplePass *pass, VCF40 *vcf, int ncid)
+{
+  int varid;
+  if (NC_NOERR != nc_inq_varid(ncid, m_varname.c_str(), &varid))
+    return false;  //storeMatrix reports it
+
+  switch (mapVCFType(m_vcftype)) {
+  case NC_INT:
+    m_decoder = new FormatDecoder<int>(new PlainTranslator<int>, m_factor, ncid, varid, m_varname.c_str());
     break;
 
-  case NC_DOUBLE: {
-    PlainTranslator<double> translator;
-    return storeMatrix(ncid, vcf, m_factor, m_varname.c_str(), m_field.c_str(), &translator);
-  }
+  case NC_DOUBLE:
+    m_decoder = new FormatDecoder<double>(new PlainTranslator<double>, m_factor, ncid, varid, m_varname.c_str());
     break;
 
   default:
     return false;
   };
 
+  vcf->formatSchemas.subfields(m_field.c_str(), &m_decoder->offsets);
+  m_decoder->snpMajor = m_snpMajor;
+  pass->add(m_decoder);
   return true;
 }
 
 
+bool VCFVariableColumnFormat::populateNetCDF(int ncid,  VCF40 *vcf)
+{
+  nc_type xtype = mapVCFType(m_vcftype);
+  if (NC_INT != xtype && NC_DOUBLE != xtype)
+    return false;
+
+  BlockBuffers ownBuffers;
+  BlockBuffers *buffers = (0 != m_buffers) ? m_buffers : &ownBuffers;
+  if (!vcf->formatDecoded && 0 == m_decoder) {  //not part of a shared pass
+    SamplePass pass(vcf);
+    joinSamplePass(&pass, vcf, ncid);
+    pass.run(m_workers, m_maxBytes);
+  }
+
+  bool result;
+  if (NC_INT == xtype)
+    result = storeMatrix<int>(ncid, vcf, m_factor, m_varname.c_str(), m_field.c_str(), m_snpMajor, m_workers, buffers,
+                              m_maxBytes);
+  else
+    result = storeMatrix<double>(ncid, vcf, m_factor, m_varname.c_str(), m_field.c_str(), m_snpMajor, m_workers, buffers,
+                                 m_maxBytes);
+  if (!vcf->formatDecoded && (0 == m_decoder || !m_decoder->ok))
+    result = false;
+
+  delete m_decoder;
+  m_decoder = 0;
+  return result;
+}
+
+
 
 
 VCFVariableGenotype::VCFVariableGenotype(const char *label)
+  : m_decoder(0)
 {
   m_varname = "array_";
   m_varname.append(label);
@@ -355,27 +533,89 @@ bool VCFVariableGenotype::updateDescription( DataSetDescription *desc )
   char dim2[128];
   snprintf(dim2, 128, "arb%i", m_number);
   desc->addDimension(dim2, m_number);
+  if (m_snpMajor)
+    return desc->addVariable(m_varname.c_str(), mapVCFType(m_vcftype), VCF_SNP_DIM, VCF_SAMPLE_DIM, dim2);
   return desc->addVariable(m_varname.c_str(), mapVCFType(m_vcftype), VCF_SAMPLE_DIM, VCF_SNP_DIM, dim2);
 }
 
 
 
-bool VCFVariableGenotype::populateNetCDF(int ncid,  VCF40 *vcf)
+//! The GT variable decoded in the SamplePass
+// Cells hold the gathered characters, the ranges translate their rows at
+// once when they finish.
+class GenotypeDecoder : public SampleDecoder {
+ public:
+  GenotypeDecoder(int ncid, int varid, const char *varname)
+    : SampleDecoder(GT_CODE_WIDTH), m_ncid(ncid), m_varid(varid), m_varname(varname) { }
+
+  bool decode(const std::vector<TextView> &fields, int subfield, size_t, unsigned char *cell,
+              std::vector<TextView> *, bool *isShort) {
+    //glfMultiples VCF file output seems to produce empty strings, and
+    //short ones seem common in vcf files, both get the defaults
+    //TODO put in back in check for 0,1,2,3 in short ones ?
+    TextView entry = ((size_t) subfield < fields.size()) ? fields[subfield] : TextView("", 0);
+    *isShort = gatherGenotype(entry, (signed char *) cell);
+    return true;
+  }
+
+  //the rows of whole samples follow each other in the cells
+  void finish(unsigned char *cells, size_t n) {
+    translateGenotypes((signed char *) cells, n);
+  }
+
+  bool store(const unsigned char *cells, size_t firstSNP, size_t nSNPs, size_t nSamples) {
+    return storeBlock(m_ncid, m_varid, m_varname, nSamples, firstSNP, nSNPs, width, snpMajor, (const signed char *) cells);
+  }
+
+ private:
+  int m_ncid;
+  int m_varid;
+  const char *m_varname;
+};
+
+
+
+VCFVariableGenotype::~VCFVariableGenotype()
 {
-  return storeAB(ncid, vcf);
+  delete m_decoder;
 }
 
 
+bool VCFVariableGenotype::joinSamplePass(SamplePass *pass, VCF40 *vcf, int ncid)
+{
+  int varid;
+  if (NC_NOERR != nc_inq_varid(ncid, m_varname.c_str(), &varid))
+    return false;  //storeAB reports it
 
+  std::vector<int> offsets;
+  vcf->formatSchemas.subfields(m_field.c_str(), &offsets);
+  for (size_t i = 0; i < vcf->nSNPs; i++) {
+    if (-1 == offsets[ vcf->format[i] ])
+      return false;  //storeAB reports it
+  }
 
+  m_decoder = new GenotypeDecoder(ncid, varid, m_varname.c_str());
+  m_decoder->offsets.swap(offsets);
+  m_decoder->snpMajor = m_snpMajor;
+  pass->add(m_decoder);
+  return true;
+}
 
-bool VCFVariableGenotype::storeAB(int ncid,  VCF40 *vcf)
+
+bool VCFVariableGenotype::populateNetCDF(int ncid,  VCF40 *vcf)
 {
-  GTTranslator<signed char> translator;
+  bool result = storeAB(ncid, vcf);
+  delete m_decoder;
+  m_decoder = 0;
+  return result;
+}
+
+
 
+bool VCFVariableGenotype::storeAB(int ncid,  VCF40 *vcf)
+{
   int nret;
   int varid;
-  size_t N = vcf->nSamples * vcf->nSNPs * m_factor;
 
   // will know that it uses integer filter ...
   //build integer filter for specific m_vcftype ?
@@ -385,73 +625,38 @@ bool VCFVariableGenotype::storeAB(int ncid,  VCF40 *vcf)
   FALSE_ON_NETCDF_ERROR(nret, "ERROR could not find variable %s\n", m_varname.c_str());
 
 
-
-  signed char *buffer = new signed char[N];
-  size_t shortFieldCount = 0;
+  std::vector<int> offsets;
+  vcf->formatSchemas.subfields(m_field.c_str(), &offsets);
   for (size_t i = 0; i < vcf->nSNPs; i++) {
-    std::vector<std::string> formatIDs = vcf->format[i];
-
-    //sspt_DelimiterParse formatParse(formatIDs.c_str(), ':', false);
-    int subfield = -1;
-    for (size_t j = 0; j < formatIDs.size() && subfield < 0; j++) {
-      //printf("-%s\n", formatIDs[j].c_str());
-      if (formatIDs[j] == m_field.c_str())  {
-        subfield = j;
-      }
-    }
-    if (subfield == -1) {
+    if (-1 == offsets[ vcf->format[i] ]) {
       fprintf(stderr, "ERROR could not find field %s in format at snp index %zu\n", m_field.c_str(), i);
       return false;
     }
+  }
 
-    for (size_t k = 0; k < vcf->nSamples; k++) {
-      std::vector<std::string> fields = vcf->sampleGenotypeInfo(i, k);
-      std::string entry = fields[subfield];
-      const char *string = entry.c_str();
-
-
-      if (0 == strlen(string)) {
-        //fprintf(stderr, "ERROR field %s is empty\n", m_field.c_str());
-        //return false;
-        //glfMultiples VCF file output seems to produce empty strings
-        shortFieldCount++;
-        const char *slash = "/";
-        const char *dot = ".";
-        buffer[ k*(vcf->nSNPs * m_factor) + i*m_factor + 0] = translator.translate( dot );
-        buffer[ k*(vcf->nSNPs * m_factor) + i*m_factor + 1] = translator.translate( slash );
-        buffer[ k*(vcf->nSNPs * m_factor) + i*m_factor + 2] = translator.translate( dot );
-      }
-      else if (strlen(string) < m_factor) {  // this seems common in vcf files 
-        shortFieldCount++;
-        const char *r1 = "/";
-        const char *r2 = ".";
-
-        buffer[ k*(vcf->nSNPs * m_factor) + i*m_factor + 0] = translator.translate( string );
-        buffer[ k*(vcf->nSNPs * m_factor) + i*m_factor + 1] = translator.translate( r1 );
-        buffer[ k*(vcf->nSNPs * m_factor) + i*m_factor + 2] = translator.translate( r2 );
-        /* TODO put in back in check for 0,1,2,3 ?
-           if ('0' == string[0])
-           else if ('1' == string[0]) {
-           else if ('2' == string[0]) {
-           else if ('3' == string[0]) {
-           fprintf(stderr, "ERROR field %s entry is too short, %s \n", m_field.c_str(), string);
-           fprintf(stderr, "cont'd: i %zu k %zu %s\n", i, k, string);
-           return false;
-           }
-        */
-      }
-      else { //normal expected case
-        for (size_t m = 0; m < m_factor; m++) {
-          buffer[ k*(vcf->nSNPs * m_factor) + i*m_factor + m] = translator.translate( string+m );
-        }
-      }
 
-    }     //end sample loop
-  } // end snp loop
+  BlockBuffers ownBuffers;
+  BlockBuffers *buffers = (0 != m_buffers) ? m_buffers : &ownBuffers;
+  if (!vcf->formatDecoded && 0 == m_decoder) {  //not part of a shared pass
+    SamplePass pass(vcf);
+    joinSamplePass(&pass, vcf, ncid);
+    pass.run(m_workers, m_maxBytes);
+  }
 
-  nret = put_var(ncid, varid, buffer);
-  delete[] buffer;
-  FALSE_ON_NETCDF_ERROR(nret, "ERROR could not write %s\n", m_varname.c_str() );
+  size_t shortFieldCount = 0;
+  if (vcf->formatDecoded) {
+    const ChunkedMatrix<signed char> *values = decodedColumn<signed char>(vcf, m_varname.c_str(), m_field.c_str(), m_factor);
+    if (0 == values)
+      return false;
+    if (!storeDecoded(ncid, varid, m_varname.c_str(), values, vcf, m_factor, m_snpMajor, m_workers, buffers, m_maxBytes))
+      return false;
+    shortFieldCount = vcf->formats.find(m_field.c_str())->shortFields;
+  }
+  else {
+    if (0 == m_decoder || !m_decoder->ok)
+      return false;
+    shortFieldCount = m_decoder->shortFields;
+  }
 
   if (shortFieldCount > 0)
     printf("Short field count %zu\n", shortFieldCount);
@@ -841,7 +1046,7 @@ bool VCFVariableRefAllele::storeAllele(int ncid, VCF40 *vcf)
   //manual is a bit unclear on meaning of startp, and countp
   size_t start[] = {0};
   size_t count[] = { vcf->nSNPs };
-  nret = nc_put_vara_string(ncid, varid, start, count, (const char**) arrayOfStrings);
+  nret = put_vara(ncid, varid, start, count, (const char **) arrayOfStrings);
 
   if (NC_NOERR != nret) {
     fprintf(stderr, "Could not write array of strings %i\n", varid);
@@ -930,7 +1135,7 @@ bool  VCFVariableAltAllele::storeAllele(int ncid,  VCF40 *vcf, size_t column)
   //manual is a bit unclear on meaning of startp, and countp
   size_t start[] = {0};
   size_t count[] = { vcf->nSNPs };
-  nret = nc_put_vara_string(ncid, varid, start, count, (const char**) arrayOfStrings);
+  nret = put_vara(ncid, varid, start, count, (const char **) arrayOfStrings);
 
   if (NC_NOERR != nret) {
     fprintf(stderr, "Could not write array of strings %i\n", varid);
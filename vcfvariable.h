@@ -9,6 +9,8 @@
 #include "sspt_cord.h"
 #include "sspt_list.h"
 
+#include "blockbuffers.h"
+
 // one idea is that this is a convient way of storing information about netcdf stuff to create
 // plus convienent way of extract item from vcf data type
 
@@ -22,6 +24,9 @@
 
 class DataSetDescription;
 class VCF40;
+class ThreadPool;
+class SamplePass;
+class SampleDecoder;
 
 class VCFVariable {
  public:
@@ -42,14 +47,31 @@ class VCFVariable {
 
   //may lead to creating multidimensional arrays with dimension name 'arb4', and similar
   //VCFVariable(enum VCFColumn column, const char *label,  nc_type xtype, int number);
+  VCFVariable() : m_workers(0), m_buffers(0), m_maxBytes((size_t) DEFAULT_MAX_MEMORY_MB << 20), m_snpMajor(false) { }
   virtual ~VCFVariable() { } 
   virtual bool updateDescription( DataSetDescription *desc )=0;
   virtual bool populateNetCDF(int ncid,  VCF40 *vcf)=0;
   virtual void variableName(sspt_Cord *name)=0;
 
- private:
+  //per-sample variables add a decoder to the shared pass over the sample
+  //strings, made before any variable is populated; true if this one did
+  virtual bool joinSamplePass(SamplePass *pass, VCF40 *vcf, int ncid) { return false; }
+
+  //threads for decoding per-sample fields, 0 to decode on the calling thread
+  void workers(ThreadPool *pool) { m_workers = pool; }
+
+  //per-sample variables are written in blocks of snps taking at most maxBytes,
+  //from buffers shared with the other variables, 0 for buffers of their own
+  void blocks(BlockBuffers *buffers, size_t maxBytes) { m_buffers = buffers; m_maxBytes = maxBytes; }
+
+  //per-sample variables are SNPs x Samples rather than Samples x SNPs, set before updateDescription()
+  void snpMajor(bool flag) { m_snpMajor = flag; }
 
-  //todo
+ protected:
+  ThreadPool *m_workers;
+  BlockBuffers *m_buffers;
+  size_t m_maxBytes;
+  bool m_snpMajor;
 };
 
 
@@ -81,9 +103,11 @@ class VCFVariableColumnFormat : public VCFVariable {
  public:
   //may lead to creating multidimensional arrays with dimension name 'arb4', and similar
   VCFVariableColumnFormat(const char *label,  enum VCFType vcftype, int number);
+  ~VCFVariableColumnFormat();
   bool updateDescription( DataSetDescription *desc );
   bool populateNetCDF(int ncid,  VCF40 *vcf);
   void variableName(sspt_Cord *name) { *name = m_varname; }
+  bool joinSamplePass(SamplePass *pass, VCF40 *vcf, int ncid);
 
  private:
 
@@ -92,6 +116,7 @@ class VCFVariableColumnFormat : public VCFVariable {
   enum VCFType m_vcftype;
   int m_number;
   size_t m_factor;
+  SampleDecoder *m_decoder;  //until populated
 
 
 };
@@ -105,9 +130,11 @@ class VCFVariableGenotype : public VCFVariable {
  public:
   //may lead to creating multidimensional arrays with dimension name 'arb4', and similar
   VCFVariableGenotype(const char *label); //,  enum VCFType vcftype, int number);
+  ~VCFVariableGenotype();
   bool updateDescription( DataSetDescription *desc );
   bool populateNetCDF(int ncid,  VCF40 *vcf);
   void variableName(sspt_Cord *name) { *name = m_varname; }
+  bool joinSamplePass(SamplePass *pass, VCF40 *vcf, int ncid);
 
  private:
   sspt_Cord m_varname;
@@ -115,6 +142,7 @@ class VCFVariableGenotype : public VCFVariable {
   enum VCFType m_vcftype;
   int m_number;
   size_t m_factor;
+  SampleDecoder *m_decoder;  //until populated
 
 
   bool storeAB(int ncid,  VCF40 *vcf);